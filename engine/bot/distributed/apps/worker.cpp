@@ -0,0 +1,105 @@
+#include "engine/bot/distributed/connection.h"
+#include "engine/bot/distributed/message.h"
+#include "engine/bot/distributed/searchworker.h"
+#include "engine/game/omega/omega.h"
+#include "engine/bot/mcts/hashtable/rzhashtable.h"
+#include "engine/bot/mcts/hashtable/zhashtable.h"
+#include "engine/bot/mcts/policy/mast.h"
+#include "engine/bot/mcts/policy/random.h"
+#include "engine/bot/mcts/exploration/uctnode.h"
+#include "engine/bot/mcts/exploration/ravenode.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// Worker process of the distributed search
+// usage: worker <address> [--once]
+// address: unix:<path> or tcp:[<host>:]<port> of the coordinator
+// the worker reconnects when the connection is lost (for example when a new game is started)
+// unless --once is given
+
+template<template<typename, typename> typename N, template<typename> typename P, template<typename> typename T>
+void serve(Connection& connection, const Message::Config& config){
+    typedef P<Omega> PP;
+    typedef N<Omega, PP> NN;
+    SearchWorker<NN, Omega, T<NN>, PP>(connection, config).serve();
+}
+
+template<template<typename, typename> typename N, template<typename> typename P>
+void serve(Connection& connection, const Message::Config& config){
+    if(config.recycling)
+        serve<N, P, RZHashTable>(connection, config);
+    else
+        serve<N, P, ZHashTable>(connection, config);
+}
+
+template<template<typename, typename> typename N>
+void serve(Connection& connection, const Message::Config& config){
+    if(config.policy == "random")
+        serve<N, RandomPolicy>(connection, config);
+    else if(config.policy == "MAST")
+        serve<N, MAST>(connection, config);
+    else
+        throw std::invalid_argument( "Invalid policy string: " + config.policy + " received" );
+}
+
+void serve(Connection& connection, const Message::Config& config){
+    if(config.node == "UCT-2")
+        serve<UCTNode>(connection, config);
+    else if(config.node == "UCT-2-compact")
+        serve<CompactUCTNode>(connection, config);
+    else if(config.node == "UCT-2-edges")
+        serve<EdgeUCTNode>(connection, config);
+    else if(config.node == "RAVE")
+        serve<RAVENode>(connection, config);
+    else if(config.node == "RAVE-sparse")
+        serve<SparseRAVENode>(connection, config);
+    else if(config.node == "RAVE-compact")
+        serve<CompactRAVENode>(connection, config);
+    else if(config.node == "RAVE-edges")
+        serve<EdgeRAVENode>(connection, config);
+    else
+        throw std::invalid_argument( "Invalid node string: " + config.node + " received" );
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2 || argc > 3 || (argc == 3 && std::string(argv[2]) != "--once")){
+        std::cerr << "usage: " << argv[0] << " <unix:<path> | tcp:[<host>:]<port>> [--once]" << std::endl;
+        return 1;
+    }
+    const std::string address = argv[1];
+    const bool once = argc == 3;
+    while(true){
+        std::unique_ptr<Connection> connection;
+        try{
+            connection = Connection::connect(address);
+        }
+        catch(std::runtime_error&){
+            // coordinator is not listening yet
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+        try{
+            // the configuration is the first message
+            Message::Type type;
+            std::vector<char> payload;
+            while(connection->receive(-1) && !connection->next(type, payload)){}
+            if(!connection->isOpen())
+                continue;
+            if(type != Message::Type::CONFIG)
+                throw std::runtime_error( "Worker: configuration was expected" );
+            Message::Config config;
+            Message::decode(payload, config);
+            serve(*connection, config);
+        }
+        catch(std::exception& e){
+            std::cerr << "Worker: " << e.what() << std::endl;
+        }
+        if(once)
+            return 0;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include "message.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**********************************************************************************
+ * Stream sockets carrying the frames of the distributed search                   *
+ * - Addresses: unix:<path> for Unix-domain sockets, tcp:<port> or                *
+ * tcp:<host>:<port> for TCP over IPv4 (host defaults to the loopback address)    *
+ * - Incoming bytes are buffered until a complete frame is received               *
+ * - A connection is closed on the first error and stays closed, lost peers are   *
+ * detected by the return values instead of exceptions (or signals)               *
+ **********************************************************************************/
+
+class Connection
+{
+public:
+    // connects to a listening socket, throws std::runtime_error on failure
+    static std::unique_ptr<Connection> connect(const std::string& address);
+
+    // takes ownership of a connected socket
+    Connection(int fd);
+    ~Connection();
+
+    Connection(const Connection&)=delete;
+    Connection& operator=(const Connection&)=delete;
+    Connection(Connection&&)=delete;
+    Connection& operator=(Connection&&)=delete;
+
+    // sends encoded frames. Without waiting the connection is closed when the frames do not fit into
+    // the socket buffer so a peer that stopped reading can not block the sender. Returns false when closed
+    bool send(const std::vector<char>& frames, bool wait=true);
+    // waits at most timeout milliseconds (-1: no limit) for incoming bytes and buffers them
+    // returns false when the connection is closed
+    bool receive(int timeout=0);
+    // takes the next complete frame from the buffer, returns false when there is none
+    bool next(Message::Type& type, std::vector<char>& payload);
+
+    bool isOpen() const;
+    void close();
+
+private:
+    int fd;
+    std::vector<char> input;
+    // bytes of the input already taken by next
+    size_t consumed;
+};
+
+class Listener
+{
+public:
+    // throws std::runtime_error when the address can not be bound
+    Listener(const std::string& address);
+    ~Listener();
+
+    Listener(const Listener&)=delete;
+    Listener& operator=(const Listener&)=delete;
+    Listener(Listener&&)=delete;
+    Listener& operator=(Listener&&)=delete;
+
+    // accepts a pending connection without blocking, nullptr when there is none
+    std::unique_ptr<Connection> accept();
+
+private:
+    int fd;
+    // path of the Unix-domain socket removed on destruction, empty for TCP
+    std::string path;
+};
+
+#endif // CONNECTION_H
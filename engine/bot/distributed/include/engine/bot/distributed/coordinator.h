@@ -0,0 +1,72 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include "connection.h"
+#include "message.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**********************************************************************************
+ * Coordinator side of the distributed search                                     *
+ * - Worker processes connect to the listening address at any time, they receive  *
+ * the configuration of their trees and the root of the running search            *
+ * - Each search has its own id, reports of earlier searches are dropped          *
+ * - The coordinator never waits for the workers: slow workers are simply merged  *
+ * with fewer visits. Workers not reporting within the timeout during a search    *
+ * and lost workers are disconnected, the last report of the search is kept       *
+ **********************************************************************************/
+
+class Coordinator
+{
+public:
+    // timeout: workers not reporting for this long during a search are disconnected
+    Coordinator(const std::string& address, const Message::Config& config,
+                std::chrono::milliseconds timeout=std::chrono::milliseconds(2000));
+
+    Coordinator(const Coordinator&)=delete;
+    Coordinator& operator=(const Coordinator&)=delete;
+    Coordinator(Coordinator&&)=delete;
+    Coordinator& operator=(Coordinator&&)=delete;
+
+    // starts a search on the workers, moves lead from the initial state of the game to the root
+    void startSearch(const std::vector<unsigned>& moves);
+    // accepts new workers and reads the reports without blocking
+    // returns true when a report of the current search has arrived
+    bool receive();
+    void stopSearch();
+
+    // workers are only removed when a search is started so the indices are stable during a search
+    unsigned getWorkerNum() const;
+    // latest report of a worker in the current search, nullptr when it has not reported yet
+    const Message::Stats* getReport(unsigned workerIdx) const;
+
+protected:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Worker{
+        std::unique_ptr<Connection> connection;
+        Message::Stats report;
+        bool reported;
+        Clock::time_point lastSeen;
+    };
+
+    void accept();
+    // sends the frames in the buffer to a worker without waiting
+    void send(Worker& worker);
+
+    Listener listener;
+    const Message::Config config;
+    const std::chrono::milliseconds timeout;
+    std::vector<Worker> workers;
+    Message::Root root;
+    bool searching;
+    // encoded frames to send
+    std::vector<char> buffer;
+    // payload of the received frame
+    std::vector<char> payload;
+};
+
+#endif // COORDINATOR_H
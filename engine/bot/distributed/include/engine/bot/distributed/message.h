@@ -0,0 +1,83 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**********************************************************************************
+ * Binary messages exchanged between the coordinator and the worker processes of  *
+ * the distributed search                                                         *
+ * - Frame: payload size (u32) | type (u8) | payload. Integers are little-endian, *
+ * floats are stored by their IEEE 754 bit pattern                                *
+ * - Moves are encoded on 16 bits, so the number of valid moves of the game       *
+ * should be less than Message::ROOT                                              *
+ * - Decoding a malformed payload throws std::runtime_error                       *
+ **********************************************************************************/
+
+class Message
+{
+public:
+    enum class Type : uint8_t{
+        CONFIG = 1, // coordinator -> worker, sent once after the connection is accepted
+        ROOT = 2,   // coordinator -> worker, starts a search
+        STOP = 3,   // coordinator -> worker, stops the search
+        STATS = 4   // worker -> coordinator, statistics of the shallow nodes
+    };
+
+    // parent of the root children in the statistics
+    static constexpr uint16_t ROOT = 0xFFFF;
+    // size of the frame header
+    static constexpr unsigned HEADERSIZE = 5;
+    // frames above this size are rejected
+    static constexpr uint32_t MAXPAYLOADSIZE = 1 << 24;
+
+    // parameters of the worker trees
+    struct Config{
+        uint32_t boardSize;
+        std::string node;
+        std::string policy;
+        bool recycling;
+        uint32_t budget;
+        // number of the most visited root children whose children are reported as well
+        uint16_t shallowNum;
+        // time between two reports of a worker in milliseconds
+        uint16_t reportInterval;
+    };
+
+    struct Root{
+        uint32_t searchId;
+        // moves from the initial state of the game to the root
+        std::vector<uint16_t> moves;
+    };
+
+    struct Stop{
+        uint32_t searchId;
+    };
+
+    struct Stats{
+        struct Entry{
+            // move of the parent root child or ROOT for the root children
+            uint16_t parent;
+            uint16_t moveIdx;
+            uint32_t visitCount;
+            float stateScore;
+        };
+        uint32_t searchId;
+        std::vector<Entry> entries;
+    };
+
+    // encoded frames are appended to the buffer
+    static void encode(const Config& config, std::vector<char>& buffer);
+    static void encode(const Root& root, std::vector<char>& buffer);
+    static void encode(const Stop& stop, std::vector<char>& buffer);
+    static void encode(const Stats& stats, std::vector<char>& buffer);
+
+    // payloads without the frame header
+    static void decode(const std::vector<char>& payload, Config& config);
+    static void decode(const std::vector<char>& payload, Root& root);
+    static void decode(const std::vector<char>& payload, Stop& stop);
+    static void decode(const std::vector<char>& payload, Stats& stats);
+};
+
+#endif // MESSAGE_H
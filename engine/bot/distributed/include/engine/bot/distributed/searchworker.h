@@ -0,0 +1,204 @@
+#ifndef SEARCHWORKER_H
+#define SEARCHWORKER_H
+
+#include "connection.h"
+#include "message.h"
+#include "engine/bot/mcts/base/mcts.h"
+#include "engine/bot/mcts/hashtable/zhashtable.h"
+#include "engine/bot/mcts/hashtable/tablesize.h"
+#include "engine/bot/scheduler/stopscheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/**********************************************************************************
+ * Worker side of the distributed search                                          *
+ * - Searches its own tree from the root received from the coordinator until the  *
+ * search is stopped and reports the statistics of the root children and of the  *
+ * children of its most visited root children periodically                        *
+ * - The tree is reused when the new root follows the previous one, otherwise     *
+ * (for example in a new game) the game and the tree are recreated                *
+ **********************************************************************************/
+
+// node, game, hashtable, policy
+template<typename N, typename G, typename T, typename P>
+class SearchWorker
+{
+public:
+    // the tree is driven by the coordinator so it does not need a scheduler
+    typedef MCTS<N, G, T, P, StopScheduler<G, T>> Tree;
+
+    SearchWorker(Connection& connection, const Message::Config& config):
+        connection(connection),
+        config(config),
+        searchId(0),
+        searching(false)
+    {
+    }
+
+    SearchWorker(const SearchWorker&)=delete;
+    SearchWorker& operator=(const SearchWorker&)=delete;
+    SearchWorker(SearchWorker&&)=delete;
+    SearchWorker& operator=(SearchWorker&&)=delete;
+
+    // serves the coordinator until the connection is closed
+    // throws std::runtime_error when an invalid message is received
+    void serve();
+
+protected:
+    typedef std::chrono::steady_clock Clock;
+
+    // creates a new game and tree at the initial state
+    void reset();
+    // updates the game and the tree by the moves leading to the new root
+    void setRoot(const std::vector<uint16_t>& moves);
+    void report();
+
+    Connection& connection;
+    const Message::Config config;
+
+    std::unique_ptr<G> game;
+    // used to list the children of the root children
+    std::unique_ptr<G> scratch;
+    // declared after the games so it is deleted first
+    std::unique_ptr<Tree> tree;
+
+    uint32_t searchId;
+    bool searching;
+    Message::Stats stats;
+    std::vector<char> buffer;
+};
+
+template<typename N, typename G, typename T, typename P>
+void SearchWorker<N, G, T, P>::serve(){
+    reset();
+    // the connection is checked at least this often during a search
+    const auto pollInterval = std::chrono::milliseconds(1);
+    const auto reportInterval = std::chrono::milliseconds(config.reportInterval);
+    auto lastReport = Clock::now();
+    Message::Type type;
+    std::vector<char> payload;
+    // frames might have been received together with the configuration
+    do{
+        while(connection.next(type, payload)){
+            if(type == Message::Type::ROOT){
+                Message::Root root;
+                Message::decode(payload, root);
+                setRoot(root.moves);
+                searchId = root.searchId;
+                searching = !game->end();
+                lastReport = Clock::now();
+            }
+            else if(type == Message::Type::STOP){
+                Message::Stop stop;
+                Message::decode(payload, stop);
+                if(stop.searchId == searchId)
+                    searching = false;
+            }
+            else
+                throw std::runtime_error( "SearchWorker: unexpected message type: " + std::to_string(static_cast<unsigned>(type)) );
+        }
+        if(!searching)
+            continue;
+        auto start = Clock::now();
+        auto now = start;
+        while(now - start < pollInterval){
+            tree->iterate();
+            now = Clock::now();
+        }
+        if(now - lastReport >= reportInterval){
+            lastReport = now;
+            report();
+        }
+    }while(connection.receive(searching ? 0 : -1));
+}
+
+template<typename N, typename G, typename T, typename P>
+void SearchWorker<N, G, T, P>::reset(){
+    tree.reset();
+    game = std::make_unique<G>(config.boardSize);
+    scratch.reset(game->clone());
+    if(game->getTotalValidMoveNum() >= Message::ROOT)
+        throw std::runtime_error( "SearchWorker: move indices do not fit into the messages" );
+    P* policy = new P(*game);
+    // nodes are created with the table
+    N::setup(game.get(), policy);
+    T* table = new T(game->getTotalValidMoveNum(), game->getMaxTurnNum(),
+                     fitHashCodeSize<T>(config.budget, game->getTotalValidMoveNum()), config.budget);
+    tree = std::make_unique<Tree>(*game, table, policy, nullptr);
+}
+
+template<typename N, typename G, typename T, typename P>
+void SearchWorker<N, G, T, P>::setRoot(const std::vector<uint16_t>& moves){
+    game->selectRoot();
+    unsigned depth = 0;
+    bool follows = moves.size() >= game->getCurrentDepth();
+    for(const auto& move : game->getTakenMoves()){
+        if(!follows)
+            break;
+        follows = game->toMoveIdx(move.getPiece(), move.getPos()) == moves[depth++];
+    }
+    if(!follows){
+        reset();
+        depth = 0;
+    }
+    for(; depth < moves.size(); ++depth){
+        unsigned moveIdx = moves[depth];
+        bool valid = false;
+        if(!game->end()){
+            for(const auto& move : game->getValidMoves()){
+                if(game->toMoveIdx(move.getPiece(), move.getPos()) == moveIdx){
+                    valid = true;
+                    break;
+                }
+            }
+        }
+        if(!valid)
+            throw std::runtime_error( "SearchWorker: invalid move received: " + std::to_string(moveIdx) );
+        game->update(moveIdx);
+        tree->updateByOpponent(moveIdx);
+    }
+}
+
+template<typename N, typename G, typename T, typename P>
+void SearchWorker<N, G, T, P>::report(){
+    game->selectRoot();
+    stats.searchId = searchId;
+    stats.entries.clear();
+    for(const auto& move : game->getValidMoves()){
+        unsigned moveIdx = game->toMoveIdx(move.getPiece(), move.getPos());
+        auto child = tree->selectRootChild(moveIdx);
+        if(child && child->getVisitCount() > 0)
+            stats.entries.push_back({Message::ROOT, static_cast<uint16_t>(moveIdx),
+                                     static_cast<uint32_t>(child->getVisitCount() + 0.5),
+                                     static_cast<float>(child->getStateScore())});
+    }
+    // children of the most visited root children
+    unsigned shallowNum = std::min<unsigned>(config.shallowNum, stats.entries.size());
+    std::partial_sort(stats.entries.begin(), stats.entries.begin() + shallowNum, stats.entries.end(),
+                      [](const auto& left, const auto& right){ return left.visitCount > right.visitCount; });
+    for(unsigned idx = 0; idx < shallowNum; ++idx){
+        unsigned moveIdx = stats.entries[idx].moveIdx;
+        scratch->selectRoot();
+        scratch->select(moveIdx);
+        if(scratch->end())
+            continue;
+        for(const auto& move : scratch->getValidMoves()){
+            unsigned childMoveIdx = scratch->toMoveIdx(move.getPiece(), move.getPos());
+            auto child = tree->selectRootGrandchild(moveIdx, childMoveIdx);
+            if(child && child->getVisitCount() > 0)
+                stats.entries.push_back({static_cast<uint16_t>(moveIdx), static_cast<uint16_t>(childMoveIdx),
+                                         static_cast<uint32_t>(child->getVisitCount() + 0.5),
+                                         static_cast<float>(child->getStateScore())});
+        }
+    }
+    buffer.clear();
+    Message::encode(stats, buffer);
+    connection.send(buffer);
+}
+
+#endif // SEARCHWORKER_H
@@ -0,0 +1,215 @@
+#include "connection.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace{
+    struct Address{
+        sockaddr_storage storage;
+        socklen_t size;
+        int family;
+        // Unix-domain socket path, empty for TCP
+        std::string path;
+    };
+
+    Address parseAddress(const std::string& address){
+        Address result;
+        std::memset(&result.storage, 0, sizeof(result.storage));
+        if(address.rfind("unix:", 0) == 0){
+            result.path = address.substr(5);
+            sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&result.storage);
+            if(result.path.empty() || result.path.size() >= sizeof(un->sun_path))
+                throw std::invalid_argument( "Connection: invalid socket path: " + result.path );
+            un->sun_family = AF_UNIX;
+            std::memcpy(un->sun_path, result.path.c_str(), result.path.size() + 1);
+            result.size = sizeof(sockaddr_un);
+            result.family = AF_UNIX;
+        }
+        else if(address.rfind("tcp:", 0) == 0){
+            std::string hostPort = address.substr(4);
+            std::string host = "127.0.0.1";
+            size_t sep = hostPort.rfind(':');
+            if(sep != std::string::npos){
+                host = hostPort.substr(0, sep);
+                hostPort = hostPort.substr(sep + 1);
+            }
+            sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&result.storage);
+            in->sin_family = AF_INET;
+            char* end;
+            unsigned long port = std::strtoul(hostPort.c_str(), &end, 10);
+            if(hostPort.empty() || *end != '\0' || port == 0 || port > 0xFFFF)
+                throw std::invalid_argument( "Connection: invalid port: " + hostPort );
+            in->sin_port = htons(port);
+            if(inet_pton(AF_INET, host.c_str(), &in->sin_addr) != 1)
+                throw std::invalid_argument( "Connection: invalid IPv4 address: " + host );
+            result.size = sizeof(sockaddr_in);
+            result.family = AF_INET;
+        }
+        else
+            throw std::invalid_argument( "Connection: invalid address: " + address + " (expected unix:<path> or tcp:[<host>:]<port>)" );
+        return result;
+    }
+
+    std::runtime_error socketError(const std::string& what, const std::string& address){
+        return std::runtime_error( "Connection: " + what + " " + address + ": " + std::strerror(errno) );
+    }
+
+    void setNoDelay(int fd, int family){
+        // statistics are sent in small frames that should not wait for each other
+        if(family == AF_INET){
+            int flag = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        }
+    }
+}
+
+std::unique_ptr<Connection> Connection::connect(const std::string& address){
+    Address addr = parseAddress(address);
+    int fd = socket(addr.family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+        throw socketError("can not create socket for", address);
+    if(::connect(fd, reinterpret_cast<sockaddr*>(&addr.storage), addr.size) < 0){
+        auto error = socketError("can not connect to", address);
+        ::close(fd);
+        throw error;
+    }
+    setNoDelay(fd, addr.family);
+    return std::make_unique<Connection>(fd);
+}
+
+Connection::Connection(int fd):
+    fd(fd),
+    consumed(0)
+{
+}
+
+Connection::~Connection(){
+    close();
+}
+
+bool Connection::isOpen() const{
+    return fd >= 0;
+}
+
+void Connection::close(){
+    if(fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+bool Connection::send(const std::vector<char>& frames, bool wait){
+    size_t sent = 0;
+    while(isOpen() && sent < frames.size()){
+        ssize_t size = ::send(fd, frames.data() + sent, frames.size() - sent, MSG_NOSIGNAL | (wait ? 0 : MSG_DONTWAIT));
+        if(size > 0)
+            sent += size;
+        else if(size < 0 && errno == EINTR)
+            continue;
+        // a partially sent frame can not be continued later, the stream is lost either way
+        else
+            close();
+    }
+    return isOpen();
+}
+
+bool Connection::receive(int timeout){
+    if(!isOpen())
+        return false;
+    pollfd pfd{fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout);
+    if(ready < 0 && errno != EINTR){
+        close();
+        return false;
+    }
+    if(ready <= 0)
+        return true;
+    // drop the frames already taken before growing the buffer
+    if(consumed > 0){
+        input.erase(input.begin(), input.begin() + consumed);
+        consumed = 0;
+    }
+    char chunk[1 << 16];
+    while(true){
+        ssize_t size = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if(size > 0){
+            input.insert(input.end(), chunk, chunk + size);
+            continue;
+        }
+        if(size < 0 && errno == EINTR)
+            continue;
+        // no more bytes for now
+        if(size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        // closed by the peer or failed
+        close();
+        return false;
+    }
+}
+
+bool Connection::next(Message::Type& type, std::vector<char>& payload){
+    size_t available = input.size() - consumed;
+    if(available < Message::HEADERSIZE)
+        return false;
+    const char* header = input.data() + consumed;
+    uint32_t size = 0;
+    for(unsigned i = 0; i < 4; ++i)
+        size |= static_cast<uint32_t>(static_cast<uint8_t>(header[i])) << (8 * i);
+    // the stream can not be resynchronized after a corrupted header
+    if(size > Message::MAXPAYLOADSIZE){
+        close();
+        input.clear();
+        consumed = 0;
+        return false;
+    }
+    if(available < Message::HEADERSIZE + size)
+        return false;
+    type = static_cast<Message::Type>(static_cast<uint8_t>(header[4]));
+    payload.assign(header + Message::HEADERSIZE, header + Message::HEADERSIZE + size);
+    consumed += Message::HEADERSIZE + size;
+    return true;
+}
+
+Listener::Listener(const std::string& address){
+    Address addr = parseAddress(address);
+    fd = socket(addr.family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if(fd < 0)
+        throw socketError("can not create socket for", address);
+    if(addr.family == AF_UNIX)
+        // socket file left behind by a previous run
+        unlink(addr.path.c_str());
+    else{
+        int flag = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    }
+    if(bind(fd, reinterpret_cast<sockaddr*>(&addr.storage), addr.size) < 0 || listen(fd, 64) < 0){
+        auto error = socketError("can not listen on", address);
+        ::close(fd);
+        throw error;
+    }
+    path = addr.path;
+}
+
+Listener::~Listener(){
+    ::close(fd);
+    if(!path.empty())
+        unlink(path.c_str());
+}
+
+std::unique_ptr<Connection> Listener::accept(){
+    sockaddr_storage addr;
+    socklen_t size = sizeof(addr);
+    int conn = accept4(fd, reinterpret_cast<sockaddr*>(&addr), &size, SOCK_CLOEXEC);
+    if(conn < 0)
+        return nullptr;
+    setNoDelay(conn, addr.ss_family);
+    return std::make_unique<Connection>(conn);
+}
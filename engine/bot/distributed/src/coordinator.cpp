@@ -0,0 +1,107 @@
+#include "coordinator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Coordinator::Coordinator(const std::string& address, const Message::Config& config, std::chrono::milliseconds timeout):
+    listener(address),
+    config(config),
+    timeout(timeout),
+    root{0, {}},
+    searching(false)
+{
+}
+
+void Coordinator::startSearch(const std::vector<unsigned>& moves){
+    workers.erase(std::remove_if(workers.begin(), workers.end(),
+                                 [](const Worker& worker){ return !worker.connection->isOpen(); }),
+                  workers.end());
+    ++root.searchId;
+    root.moves.clear();
+    for(auto moveIdx : moves){
+        if(moveIdx >= Message::ROOT)
+            throw std::invalid_argument( "Coordinator: move index does not fit into the message: " + std::to_string(moveIdx) );
+        root.moves.push_back(moveIdx);
+    }
+    searching = true;
+
+    buffer.clear();
+    Message::encode(root, buffer);
+    auto now = Clock::now();
+    for(auto& worker : workers){
+        worker.reported = false;
+        worker.report.entries.clear();
+        worker.lastSeen = now;
+        send(worker);
+    }
+    accept();
+}
+
+void Coordinator::stopSearch(){
+    searching = false;
+    buffer.clear();
+    Message::encode(Message::Stop{root.searchId}, buffer);
+    for(auto& worker : workers)
+        send(worker);
+}
+
+bool Coordinator::receive(){
+    accept();
+    bool received = false;
+    auto now = Clock::now();
+    for(auto& worker : workers){
+        Connection& connection = *worker.connection;
+        connection.receive();
+        Message::Type type;
+        while(connection.next(type, payload)){
+            if(type != Message::Type::STATS){
+                connection.close();
+                break;
+            }
+            Message::Stats report;
+            try{
+                Message::decode(payload, report);
+            }
+            catch(std::runtime_error&){
+                connection.close();
+                break;
+            }
+            worker.lastSeen = now;
+            if(report.searchId == root.searchId){
+                worker.report = std::move(report);
+                worker.reported = true;
+                received = true;
+            }
+        }
+        if(searching && connection.isOpen() && now - worker.lastSeen > timeout)
+            connection.close();
+    }
+    return received;
+}
+
+unsigned Coordinator::getWorkerNum() const{
+    return workers.size();
+}
+
+const Message::Stats* Coordinator::getReport(unsigned workerIdx) const{
+    const Worker& worker = workers[workerIdx];
+    return worker.reported ? &worker.report : nullptr;
+}
+
+void Coordinator::accept(){
+    while(auto connection = listener.accept()){
+        Worker worker{std::move(connection), {root.searchId, {}}, false, Clock::now()};
+        buffer.clear();
+        Message::encode(config, buffer);
+        // workers joining during a search start searching right away
+        if(searching)
+            Message::encode(root, buffer);
+        send(worker);
+        if(worker.connection->isOpen())
+            workers.push_back(std::move(worker));
+    }
+}
+
+void Coordinator::send(Worker& worker){
+    worker.connection->send(buffer, false);
+}
@@ -0,0 +1,196 @@
+#include "message.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace{
+    class Writer{
+    public:
+        // reserves the frame header, the payload size is set by finish
+        Writer(std::vector<char>& buffer, Message::Type type):
+            buffer(buffer),
+            start(buffer.size())
+        {
+            u32(0);
+            u8(static_cast<uint8_t>(type));
+        }
+
+        void finish(){
+            uint32_t size = buffer.size() - start - Message::HEADERSIZE;
+            for(unsigned i = 0; i < 4; ++i)
+                buffer[start + i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+        }
+
+        void u8(uint8_t value){
+            buffer.push_back(static_cast<char>(value));
+        }
+        void u16(uint16_t value){
+            for(unsigned i = 0; i < 2; ++i)
+                buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+        void u32(uint32_t value){
+            for(unsigned i = 0; i < 4; ++i)
+                buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+        void f32(float value){
+            static_assert(sizeof(float) == sizeof(uint32_t), "Message: 32 bit floats are expected");
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            u32(bits);
+        }
+        void str(const std::string& value){
+            if(value.size() > 0xFF)
+                throw std::invalid_argument( "Message: string is too long: " + value );
+            u8(value.size());
+            buffer.insert(buffer.end(), value.begin(), value.end());
+        }
+
+    private:
+        std::vector<char>& buffer;
+        const size_t start;
+    };
+
+    class Reader{
+    public:
+        Reader(const std::vector<char>& payload):
+            payload(payload),
+            pos(0)
+        {
+        }
+
+        // the whole payload should be consumed
+        void finish() const{
+            if(pos != payload.size())
+                throw std::runtime_error( "Message: unexpected bytes at the end of the payload" );
+        }
+
+        uint8_t u8(){
+            check(1);
+            return static_cast<uint8_t>(payload[pos++]);
+        }
+        uint16_t u16(){
+            check(2);
+            uint16_t value = 0;
+            for(unsigned i = 0; i < 2; ++i)
+                value |= static_cast<uint16_t>(static_cast<uint8_t>(payload[pos++])) << (8 * i);
+            return value;
+        }
+        uint32_t u32(){
+            check(4);
+            uint32_t value = 0;
+            for(unsigned i = 0; i < 4; ++i)
+                value |= static_cast<uint32_t>(static_cast<uint8_t>(payload[pos++])) << (8 * i);
+            return value;
+        }
+        float f32(){
+            uint32_t bits = u32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        std::string str(){
+            unsigned size = u8();
+            check(size);
+            std::string value(payload.begin() + pos, payload.begin() + pos + size);
+            pos += size;
+            return value;
+        }
+
+    private:
+        void check(size_t size) const{
+            if(payload.size() - pos < size)
+                throw std::runtime_error( "Message: truncated payload" );
+        }
+
+        const std::vector<char>& payload;
+        size_t pos;
+    };
+}
+
+void Message::encode(const Config& config, std::vector<char>& buffer){
+    Writer writer(buffer, Type::CONFIG);
+    writer.u32(config.boardSize);
+    writer.str(config.node);
+    writer.str(config.policy);
+    writer.u8(config.recycling);
+    writer.u32(config.budget);
+    writer.u16(config.shallowNum);
+    writer.u16(config.reportInterval);
+    writer.finish();
+}
+
+void Message::encode(const Root& root, std::vector<char>& buffer){
+    Writer writer(buffer, Type::ROOT);
+    writer.u32(root.searchId);
+    writer.u32(root.moves.size());
+    for(auto moveIdx : root.moves)
+        writer.u16(moveIdx);
+    writer.finish();
+}
+
+void Message::encode(const Stop& stop, std::vector<char>& buffer){
+    Writer writer(buffer, Type::STOP);
+    writer.u32(stop.searchId);
+    writer.finish();
+}
+
+void Message::encode(const Stats& stats, std::vector<char>& buffer){
+    Writer writer(buffer, Type::STATS);
+    writer.u32(stats.searchId);
+    writer.u32(stats.entries.size());
+    for(const auto& entry : stats.entries){
+        writer.u16(entry.parent);
+        writer.u16(entry.moveIdx);
+        writer.u32(entry.visitCount);
+        writer.f32(entry.stateScore);
+    }
+    writer.finish();
+}
+
+void Message::decode(const std::vector<char>& payload, Config& config){
+    Reader reader(payload);
+    config.boardSize = reader.u32();
+    config.node = reader.str();
+    config.policy = reader.str();
+    config.recycling = reader.u8();
+    config.budget = reader.u32();
+    config.shallowNum = reader.u16();
+    config.reportInterval = reader.u16();
+    reader.finish();
+}
+
+void Message::decode(const std::vector<char>& payload, Root& root){
+    Reader reader(payload);
+    root.searchId = reader.u32();
+    uint32_t moveNum = reader.u32();
+    // every move takes 2 bytes, this prevents huge allocations from corrupted sizes
+    if(moveNum > payload.size() / 2)
+        throw std::runtime_error( "Message: invalid number of moves" );
+    root.moves.resize(moveNum);
+    for(auto& moveIdx : root.moves)
+        moveIdx = reader.u16();
+    reader.finish();
+}
+
+void Message::decode(const std::vector<char>& payload, Stop& stop){
+    Reader reader(payload);
+    stop.searchId = reader.u32();
+    reader.finish();
+}
+
+void Message::decode(const std::vector<char>& payload, Stats& stats){
+    Reader reader(payload);
+    stats.searchId = reader.u32();
+    uint32_t entryNum = reader.u32();
+    // every entry takes 12 bytes
+    if(entryNum > payload.size() / 12)
+        throw std::runtime_error( "Message: invalid number of entries" );
+    stats.entries.resize(entryNum);
+    for(auto& entry : stats.entries){
+        entry.parent = reader.u16();
+        entry.moveIdx = reader.u16();
+        entry.visitCount = reader.u32();
+        entry.stateScore = reader.f32();
+    }
+    reader.finish();
+}
@@ -0,0 +1,40 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>
+#include <vector>
+
+/**********************************************************************************
+ * Thread affinity map for the search threads                                     *
+ * - Map formats: empty (no pinning), "auto" (threads are spread over the NUMA    *
+ * nodes in turn) or a list of CPUs and CPU ranges like "0,2,8-11". Thread i runs *
+ * on the (i mod size)th CPU of the list                                          *
+ * - NUMA topology is read from sysfs, without it every CPU is on node 0          *
+ **********************************************************************************/
+
+class Affinity
+{
+public:
+    Affinity(const std::string& map);
+
+    bool empty() const;
+    unsigned getCpu(unsigned threadIdx) const;
+    unsigned getNode(unsigned threadIdx) const;
+    // pins the calling thread, returns false when it is not possible (like when the CPU is not available)
+    bool pin(unsigned threadIdx) const;
+    // a CPU of each NUMA node used by the first threadNum threads in the order of the first use
+    std::vector<unsigned> getNodeCpus(unsigned threadNum) const;
+
+    static bool pinCpu(unsigned cpu);
+    static unsigned nodeOf(unsigned cpu);
+
+private:
+    // CPU lists like "0-3,8"
+    static std::vector<unsigned> parseList(const std::string& list);
+
+    std::vector<unsigned> cpus;
+    // NUMA node of each CPU in the map
+    std::vector<unsigned> nodes;
+};
+
+#endif // AFFINITY_H
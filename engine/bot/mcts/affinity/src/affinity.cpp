@@ -0,0 +1,131 @@
+#include "affinity.h"
+
+#include <algorithm>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace{
+    // first line of a sysfs file, empty when it can not be read
+    std::string readLine(const std::string& path){
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+}
+
+Affinity::Affinity(const std::string& map){
+    if(map.empty())
+        return;
+    if(map == "auto"){
+        std::vector<std::vector<unsigned>> nodeCpus;
+        std::string online = readLine("/sys/devices/system/node/online");
+        if(!online.empty()){
+            for(unsigned node : parseList(online))
+                nodeCpus.push_back(parseList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")));
+        }
+        if(nodeCpus.empty()){
+            nodeCpus.emplace_back();
+            for(unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                nodeCpus.back().push_back(cpu);
+        }
+        // consecutive threads go to different nodes
+        size_t maxSize = 0;
+        for(const auto& list : nodeCpus)
+            maxSize = std::max(maxSize, list.size());
+        for(size_t idx = 0; idx < maxSize; ++idx){
+            for(const auto& list : nodeCpus){
+                if(idx < list.size())
+                    cpus.push_back(list[idx]);
+            }
+        }
+    }
+    else
+        cpus = parseList(map);
+    if(cpus.empty())
+        throw std::invalid_argument( "Affinity: no CPU in map: " + map );
+    for(unsigned cpu : cpus)
+        nodes.push_back(nodeOf(cpu));
+}
+
+std::vector<unsigned> Affinity::parseList(const std::string& list){
+    std::vector<unsigned> result;
+    std::stringstream stream(list);
+    std::string item;
+    while(std::getline(stream, item, ',')){
+        if(item.empty())
+            continue;
+        size_t sep = item.find('-');
+        try{
+            size_t pos;
+            unsigned first = std::stoul(item.substr(0, sep), &pos);
+            if(pos != (sep == std::string::npos ? item.size() : sep))
+                throw std::invalid_argument(item);
+            unsigned last = first;
+            if(sep != std::string::npos){
+                last = std::stoul(item.substr(sep + 1), &pos);
+                if(pos != item.size() - sep - 1)
+                    throw std::invalid_argument(item);
+            }
+            if(last < first || last >= CPU_SETSIZE)
+                throw std::invalid_argument(item);
+            for(unsigned cpu = first; cpu <= last; ++cpu)
+                result.push_back(cpu);
+        }
+        catch(std::exception&){
+            throw std::invalid_argument( "Affinity: invalid CPU list: " + list );
+        }
+    }
+    return result;
+}
+
+bool Affinity::empty() const{
+    return cpus.empty();
+}
+
+unsigned Affinity::getCpu(unsigned threadIdx) const{
+    return cpus[threadIdx % cpus.size()];
+}
+
+unsigned Affinity::getNode(unsigned threadIdx) const{
+    return nodes[threadIdx % nodes.size()];
+}
+
+bool Affinity::pin(unsigned threadIdx) const{
+    return !empty() && pinCpu(getCpu(threadIdx));
+}
+
+std::vector<unsigned> Affinity::getNodeCpus(unsigned threadNum) const{
+    std::vector<unsigned> usedNodes;
+    std::vector<unsigned> result;
+    for(unsigned threadIdx = 0; threadIdx < std::min<size_t>(threadNum, cpus.size()); ++threadIdx){
+        if(std::find(usedNodes.begin(), usedNodes.end(), getNode(threadIdx)) == usedNodes.end()){
+            usedNodes.push_back(getNode(threadIdx));
+            result.push_back(getCpu(threadIdx));
+        }
+    }
+    return result;
+}
+
+bool Affinity::pinCpu(unsigned cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+unsigned Affinity::nodeOf(unsigned cpu){
+    std::string online = readLine("/sys/devices/system/node/online");
+    if(online.empty())
+        return 0;
+    for(unsigned node : parseList(online)){
+        auto nodeCpus = parseList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+        if(std::find(nodeCpus.begin(), nodeCpus.end(), cpu) != nodeCpus.end())
+            return node;
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#ifndef DISTRIBUTEDMCTS_H
+#define DISTRIBUTEDMCTS_H
+
+#include "mcts.h"
+#include "rootstatistics.h"
+#include "engine/bot/distributed/coordinator.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+/**********************************************************************************
+ * Root parallelisation over worker processes                                     *
+ * - The coordinator searches its own tree and starts a search from the same      *
+ * root on the connected workers (see the worker app of engine/bot/distributed)   *
+ * - Workers report the statistics of the root children and of the children of    *
+ * their most visited root children periodically. The scheduler and the final     *
+ * move selection use the statistics of the local tree merged with the latest     *
+ * reports, like in the root parallel search                                      *
+ * - The statistics of the children of the root children are used for the         *
+ * remaining moves of the turn (one player might have multiple moves in a turn)   *
+ **********************************************************************************/
+
+// node, game, hashtable, policy, scheduler inspecting RootStatistics
+template<typename N, typename G, typename T, typename P, typename S>
+class DistributedMCTS: public MCTSBase
+{
+public:
+    typedef MCTS<N, G, T, P, S> Tree;
+
+    // reports are read at most once in pollInterval
+    DistributedMCTS(G& game, T* table, RootStatistics* stats, S* scheduler, Coordinator* coordinator,
+                    std::chrono::milliseconds pollInterval=std::chrono::milliseconds(5)):
+        game(game),
+        treeGame(game.clone()),
+        trees{new Tree(*treeGame, table, new P(*treeGame), nullptr)},
+        stats(stats),
+        scheduler(scheduler),
+        coordinator(coordinator),
+        pollInterval(pollInterval)
+    {
+    }
+
+    DistributedMCTS(const DistributedMCTS&)=delete;
+    DistributedMCTS& operator=(const DistributedMCTS&)=delete;
+    DistributedMCTS(DistributedMCTS&&)=delete;
+    DistributedMCTS& operator=(DistributedMCTS&&)=delete;
+
+    virtual ~DistributedMCTS(){
+        delete trees[0];
+        delete treeGame;
+        delete coordinator;
+        delete scheduler;
+        delete stats;
+    }
+
+    virtual void updateByOpponent(unsigned int moveIdx) final{
+        // workers follow the game when the next search is started
+        trees[0]->updateByOpponent(moveIdx);
+    }
+
+    virtual void run() override{
+        bool finished = startSearch();
+        while(!interrupt.load() && !finished)
+            finished = searchStep(1);
+        if(finished)
+            finishSearch();
+        else
+            coordinator->stopSearch();
+    }
+
+    virtual bool startSearch() override{
+        stopPondering();
+        // game is only used to list the root children, it stays at the root during the search
+        game.selectRoot();
+        stats->setRoot(game, trees);
+        std::vector<unsigned> moves;
+        for(const auto& move : game.getTakenMoves())
+            moves.push_back(game.toMoveIdx(move.getPiece(), move.getPos()));
+        coordinator->startSearch(moves);
+        lastPoll = Clock::now();
+        scheduler->schedule();
+        interrupt.store(false);
+        return scheduler->finish();
+    }
+
+    virtual bool searchStep(unsigned iterationNum) override{
+        for(unsigned i = 0; i < iterationNum; ++i){
+            trees[0]->iterate();
+            stats->publish(0, *trees[0]);
+            auto now = Clock::now();
+            if(now - lastPoll >= pollInterval){
+                lastPoll = now;
+                if(coordinator->receive())
+                    publishReports({});
+            }
+            if(scheduler->finish())
+                return true;
+        }
+        return false;
+    }
+
+    virtual void finishSearch() override{
+        coordinator->receive();
+        coordinator->stopSearch();
+        publishReports({});
+        // moves selected in this turn
+        std::vector<unsigned> path;
+        unsigned rootPlayer = game.getNextPlayer();
+        unsigned currPlayer;
+        // update root by the best move according to the merged statistics
+        do{
+            unsigned bestMoveIdx = Node::mostVisited(stats, &game);
+            game.update(bestMoveIdx);
+            trees[0]->updateByOpponent(bestMoveIdx);
+            path.push_back(bestMoveIdx);
+            stats->setRoot(game, trees);
+            publishReports(path);
+            currPlayer = game.getNextPlayer();
+        }while(rootPlayer == currPlayer); // one player might have multiple moves in a turn
+    }
+
+    virtual void stop() override{
+        interrupt.store(true);
+    }
+
+    virtual void startPondering() override{
+        trees[0]->startPondering();
+    }
+
+    virtual void stopPondering() override{
+        trees[0]->stopPondering();
+    }
+
+protected:
+    typedef std::chrono::steady_clock Clock;
+
+    // publishes the latest reports of the workers for the children of the node reached by the path from the root
+    // of the search, workers only report the nodes up to the children of the root children
+    void publishReports(const std::vector<unsigned>& path){
+        for(unsigned workerIdx = 0; workerIdx < coordinator->getWorkerNum(); ++workerIdx){
+            unsigned sourceIdx = trees.size() + workerIdx;
+            stats->clear(sourceIdx);
+            auto report = coordinator->getReport(workerIdx);
+            if(!report || path.size() > 1)
+                continue;
+            unsigned parent = path.empty() ? Message::ROOT : path[0];
+            for(const auto& entry : report->entries){
+                if(entry.parent == parent)
+                    stats->publish(sourceIdx, entry.moveIdx, entry.visitCount, entry.stateScore);
+            }
+        }
+    }
+
+    G& game;
+    G* const treeGame;
+    // local tree, kept in a vector for the statistics
+    std::vector<Tree*> trees;
+    RootStatistics* const stats;
+    S* const scheduler;
+    Coordinator* const coordinator;
+
+    std::atomic<bool> interrupt;
+    const std::chrono::milliseconds pollInterval;
+    Clock::time_point lastPoll;
+};
+
+#endif // DISTRIBUTEDMCTS_H
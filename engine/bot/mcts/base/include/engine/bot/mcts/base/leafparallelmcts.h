@@ -0,0 +1,141 @@
+#ifndef LEAFPARALLELMCTS_H
+#define LEAFPARALLELMCTS_H
+
+#include "mcts.h"
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+/**********************************************************************************
+ * Leaf parallelisation                                                           *
+ * - Selection and expansion are done once on the calling thread, then a batch of *
+ * playouts is run from the same leaf: one on the search game and the rest on     *
+ * a pool of rollout threads working on copies of the leaf state                  *
+ * - The mean outcome of the batch is backpropagated once with the batch size as  *
+ * weight, so the tree walk and the table probes are amortised over the batch     *
+ **********************************************************************************/
+
+// node, game, hashtable, policy, scheduler
+template<typename N, typename G, typename T, typename P, typename S>
+class LeafParallelMCTS: public MCTS<N, G, T, P, S>
+{
+    typedef MCTS<N, G, T, P, S> Base;
+public:
+    // batchSize: number of playouts per search cycle, batchSize - 1 rollout threads are started
+    LeafParallelMCTS(G& game, T* table, P* policy, S* scheduler, unsigned batchSize):
+        Base(game, table, policy, scheduler),
+        batchSize(batchSize),
+        leafGame(game.clone()),
+        batch(0),
+        pending(0),
+        quit(false)
+    {
+        rollouts.reserve(batchSize - 1);
+        for(unsigned i = 1; i < batchSize; ++i){
+            G* rolloutGame = game.clone();
+            rollouts.push_back({rolloutGame, new P(*rolloutGame), 0.0});
+        }
+        threads.reserve(rollouts.size());
+        for(unsigned idx = 0; idx < rollouts.size(); ++idx)
+            threads.emplace_back(&LeafParallelMCTS::rollout, this, idx);
+    }
+
+    virtual ~LeafParallelMCTS(){
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            quit = true;
+        }
+        start.notify_all();
+        for(auto& thread : threads)
+            thread.join();
+        for(auto& rollout : rollouts){
+            delete rollout.policy;
+            delete rollout.game;
+        }
+        delete leafGame;
+    }
+
+    virtual void updateByOpponent(unsigned int moveIdx) override{
+        Base::updateByOpponent(moveIdx);
+        for(auto& rollout : rollouts)
+            rollout.policy->updateRoot();
+    }
+
+    virtual void iterate() override{
+        N::setup(&game, policy);
+        game.selectRoot();
+        N* leaf;
+        unsigned leafDepth = selection(table, game, leaf, batchSize);
+        double outcome;
+        // terminal leaves have a deterministic outcome
+        if(rollouts.empty() || game.end())
+            outcome = policy->simulate();
+        else{
+            // rollout threads only read the copy so the search game can be simulated in the meantime
+            leafGame->assign(game);
+            {
+                std::lock_guard<std::mutex> lock(poolMutex);
+                pending = rollouts.size();
+                ++batch;
+            }
+            start.notify_all();
+            outcome = policy->simulate();
+            std::unique_lock<std::mutex> lock(poolMutex);
+            finished.wait(lock, [this]{ return pending == 0; });
+            for(const auto& rollout : rollouts)
+                outcome += rollout.outcome;
+            outcome /= batchSize;
+        }
+        leaf->backprop(outcome, table, leafDepth, batchSize);
+    }
+
+protected:
+    using Base::game;
+    using Base::table;
+    using Base::policy;
+    using Base::selection;
+
+    // resources of a rollout thread
+    struct Rollout{
+        G* game;
+        P* policy;
+        double outcome;
+    };
+
+    void rollout(unsigned idx){
+        Rollout& rollout = rollouts[idx];
+        unsigned long long last = 0;
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(poolMutex);
+                start.wait(lock, [this, last]{ return quit || batch != last; });
+                if(quit)
+                    return;
+                last = batch;
+            }
+            rollout.game->assign(*leafGame);
+            rollout.outcome = rollout.policy->simulate();
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if(--pending == 0)
+                finished.notify_one();
+        }
+    }
+
+    const unsigned batchSize;
+    // leaf state of the current batch
+    G* const leafGame;
+    std::vector<Rollout> rollouts;
+    std::vector<std::thread> threads;
+
+    // guards the batch counter, the number of pending rollouts and quit
+    std::mutex poolMutex;
+    std::condition_variable start;
+    std::condition_variable finished;
+    unsigned long long batch;
+    unsigned pending;
+    bool quit;
+};
+
+#endif // LEAFPARALLELMCTS_H
@@ -2,8 +2,12 @@
 #define MCTS_H
 
 #include "engine/bot/mcts/exploration/node.h"
+#include "engine/bot/mcts/affinity/affinity.h"
 #include <stdexcept>
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 // Type erasure
 class MCTSBase{
@@ -19,10 +23,30 @@ public:
     virtual void run()=0;
     virtual void stop()=0;
     virtual void updateByOpponent(unsigned moveIdx)=0;
+
+    // keeps searching from the current root on background threads until stopPondering is called
+    // the tree is kept so the search can be continued from the child selected by the opponent
+    virtual void startPondering()=0;
+    virtual void stopPondering()=0;
+
+    // ---- incremental search driven by the caller (like the search server) ----
+    // prepares a search from the current root, returns true when the scheduler finished it right away
+    virtual bool startSearch()=0;
+    // runs at most iterationNum search cycles on the calling thread, returns true when the scheduler finished the search
+    virtual bool searchStep(unsigned iterationNum)=0;
+    // updates the root by the best move(s)
+    virtual void finishSearch()=0;
 };
 
 /**********************************************************************************
  * Fully customizable Monte Carlo tree search implementation                       *
+ *                                                                                *
+ * Tree parallelisation: with threadNum > 1 each search thread works on its own   *
+ * game, policy and worker table sharing the nodes of the main table. Selection,  *
+ * expansion and backpropagation are guarded by a single mutex while the          *
+ * simulations (dominating the cost of an iteration) run concurrently. Threads    *
+ * are spread over the tree by virtual loss applied during selection.             *
+ * Search and pondering threads are pinned to CPUs by an optional affinity map.   *
  **********************************************************************************/
 
 // node, game, hashtable, policy, scheduler
@@ -30,13 +54,31 @@ template<typename N, typename G, typename T, typename P, typename S>
 class MCTS: public MCTSBase
 {
 public:
-    MCTS(G& game, T* table, P* policy, S* scheduler):
+    MCTS(G& game, T* table, P* policy, S* scheduler, unsigned threadNum=1, Affinity* affinity=nullptr):
         table(table),
         game(game),
         policy(policy),
         scheduler(scheduler),
-        root(table->createRoot())
+        affinity(affinity),
+        root(table->createRoot()),
+        ponderRoot(game.clone()),
+        ponderWorker{nullptr, nullptr, table}
     {
+        // the main game, policy and table are not used for selection when the search is parallelised
+        // so the scheduler can inspect the root while the threads are running
+        if(threadNum > 1){
+            workers.reserve(threadNum);
+            for(unsigned i = 0; i < threadNum; ++i){
+                G* workerGame = game.clone();
+                workers.push_back({workerGame, new P(*workerGame), table->createWorker()});
+            }
+        }
+        // search threads ponder on their own resources, otherwise a separate game and policy is needed
+        // the main ones might be shared with the caller
+        else{
+            ponderWorker.game = game.clone();
+            ponderWorker.policy = new P(*ponderWorker.game);
+        }
     }
 
     MCTS(const MCTS&)=delete;
@@ -45,57 +87,212 @@ public:
     MCTS& operator=(const MCTS&&)=delete;
 
     virtual ~MCTS(){
+        stopPondering();
+        delete ponderWorker.policy;
+        delete ponderWorker.game;
+        delete ponderRoot;
+        for(auto& worker : workers){
+            delete worker.table;
+            delete worker.policy;
+            delete worker.game;
+        }
         delete table;
         delete scheduler;
         delete policy;
+        delete affinity;
     }
 
-    virtual void updateByOpponent(unsigned int moveIdx) final{
+    virtual void updateByOpponent(unsigned int moveIdx) override{
         // game state should be updated in the UI
         // for example if we reach a terminal state the UI should stop the gameplay
+        // the game might be a copy of the one in the UI, that is only updated through the shared root state
+        stopPondering();
+        game.selectRoot();
+        N::setup(&game, policy);
         root = table->updateRoot(moveIdx);
         policy->updateRoot();
+        if(ponderWorker.policy)
+            ponderWorker.policy->updateRoot();
+        for(auto& worker : workers)
+            worker.policy->updateRoot();
     }
 
     virtual void run() override{
+        bool finished = startSearch();
+        if(workers.empty()){
+            while(!interrupt.load() && !finished)
+                finished = searchStep(1);
+        }
+        else if(!finished){
+            done.store(false);
+            std::vector<std::thread> threads;
+            threads.reserve(workers.size());
+            for(auto& worker : workers)
+                threads.emplace_back(&MCTS::search, this, std::ref(worker));
+            for(auto& thread : threads)
+                thread.join();
+            finished = done.load();
+        }
+        if(finished)
+            finishSearch();
+    }
+
+    virtual bool startSearch() override{
+        stopPondering();
+        // nodes access the game and policy of the thread running the search
+        N::setup(&game, policy);
         scheduler->schedule();
         interrupt.store(false);
-        bool finished = scheduler->finish();
-        while(!interrupt.load() && !finished){
-            game.selectRoot();
-            unsigned leafDepth = selection();
-            double outcome = policy->simulate();
-            leaf->backprop(outcome, table, leafDepth);
-            finished = scheduler->finish();
-        }
-        if(finished){
-            game.selectRoot();
-            unsigned rootPlayer = game.getNextPlayer();
-            unsigned currPlayer;
-            // update root by the best move
-            do{
-                root = Node::selectMostVisited(table, &game);
-                currPlayer = game.getNextPlayer();
-            }while(rootPlayer == currPlayer); // one player might have multiple moves in a turn
+        return scheduler->finish();
+    }
+
+    virtual bool searchStep(unsigned iterationNum) override{
+        for(unsigned i = 0; i < iterationNum; ++i){
+            iterate();
+            if(scheduler->finish())
+                return true;
         }
+        return false;
+    }
+
+    virtual void finishSearch() override{
+        N::setup(&game, policy);
+        game.selectRoot();
+        unsigned rootPlayer = game.getNextPlayer();
+        unsigned currPlayer;
+        // update root by the best move
+        do{
+            root = Node::selectMostVisited(table, &game);
+            currPlayer = game.getNextPlayer();
+        }while(rootPlayer == currPlayer); // one player might have multiple moves in a turn
     }
 
     virtual void stop() override{
         interrupt.store(true);
     }
+
+    // a single search cycle from the root on the calling thread without checking the scheduler
+    // used when the search is driven from outside like in root parallelisation
+    virtual void iterate(){
+        N::setup(&game, policy);
+        game.selectRoot();
+        N* leaf;
+        unsigned leafDepth = selection(table, game, leaf);
+        double outcome = policy->simulate();
+        leaf->backprop(outcome, table, leafDepth);
+    }
+
+    virtual void startPondering() override{
+        if(!ponderThreads.empty() || game.end())
+            return;
+        // the shared root state might be updated by the caller in the meantime (for example by the move of
+        // the opponent) so the pondering threads start their iterations from a snapshot of the root
+        ponderRoot->assign(game);
+        ponderInterrupt.store(false);
+        if(workers.empty())
+            ponderThreads.emplace_back(&MCTS::ponder, this, std::ref(ponderWorker));
+        else{
+            ponderThreads.reserve(workers.size());
+            for(auto& worker : workers)
+                ponderThreads.emplace_back(&MCTS::ponder, this, std::ref(worker));
+        }
+    }
+
+    virtual void stopPondering() override{
+        ponderInterrupt.store(true);
+        for(auto& thread : ponderThreads)
+            thread.join();
+        ponderThreads.clear();
+    }
+
+    // statistics of a root child, nullptr when it is not in the table
+    const N* selectRootChild(unsigned moveIdx) const{
+        return table->select(moveIdx);
+    }
+
+    // statistics of a child of a root child, nullptr when either of them is not in the table
+    // the tree should not be searched meanwhile
+    const N* selectRootGrandchild(unsigned moveIdx, unsigned childMoveIdx){
+        N* node = table->select(moveIdx);
+        if(!node)
+            return nullptr;
+        table->update(moveIdx, node);
+        const N* child = table->select(childMoveIdx);
+        // back to the root, the second call resets the table for the next selection like a backpropagation
+        table->backward();
+        table->backward();
+        return child;
+    }
 protected:
-    unsigned selection(){
+    // resources of a search thread
+    struct Worker{
+        G* game;
+        P* policy;
+        T* table;
+    };
+
+    // pins the thread of a worker by the affinity map
+    void pin(const Worker& worker){
+        if(affinity)
+            affinity->pin(&worker == &ponderWorker ? 0 : &worker - workers.data());
+    }
+
+    void search(Worker& worker){
+        pin(worker);
+        N::setup(worker.game, worker.policy);
+        while(!interrupt.load() && !done.load()){
+            N* leaf;
+            unsigned leafDepth;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // a node from the search path might have been recycled by an other thread in which case
+                // the previous backpropagation stopped before reaching the root
+                worker.table->selectRoot();
+                worker.game->selectRoot();
+                leafDepth = selection(worker.table, *worker.game, leaf);
+            }
+            double outcome = worker.policy->simulate();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                leaf->backprop(outcome, worker.table, leafDepth);
+                if(scheduler->finish())
+                    done.store(true);
+            }
+        }
+    }
+
+    // weight: number of playouts that will be run from the leaf
+    // search iterations without a scheduler
+    void ponder(Worker& worker){
+        pin(worker);
+        N::setup(worker.game, worker.policy);
+        while(!ponderInterrupt.load()){
+            N* leaf;
+            unsigned leafDepth;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                worker.table->selectRoot();
+                worker.game->assign(*ponderRoot);
+                leafDepth = selection(worker.table, *worker.game, leaf);
+            }
+            double outcome = worker.policy->simulate();
+            std::lock_guard<std::mutex> lock(mutex);
+            leaf->backprop(outcome, worker.table, leafDepth);
+        }
+    }
+
+    unsigned selection(T* const table, G& game, N*& leaf, unsigned weight=1){
         leaf = root;
-        auto child = root->select(table);
+        auto child = root->select(table, weight);
         // game.end() should return false when the search depth exceeds a predefined maximum.
         // this is to prevent infinite loops in state loops
         while(!game.end() and child){
             leaf = child;
-            child = child->select(table);
+            child = child->select(table, weight);
         }
         unsigned leafDepth = game.getCurrentDepth();
         // in an existing terminal node or can we expand?
-        leaf = child ? child : leaf->expand(table);
+        leaf = child ? child : leaf->expand(table, weight);
         return leafDepth;
     }
 
@@ -103,10 +300,26 @@ protected:
     G& game;
     P* const policy;
     S* const scheduler;
+    // nullptr when the threads are not pinned
+    const Affinity* const affinity;
     N* root;
-    N* leaf;
 
     std::atomic<bool> interrupt;
+
+    // ---- tree parallelisation ----
+    std::vector<Worker> workers;
+    // guards the shared nodes and table entries
+    std::mutex mutex;
+    // set by the thread whose scheduler check finished the search
+    std::atomic<bool> done;
+
+    // ---- pondering ----
+    // root state when the pondering was started
+    G* const ponderRoot;
+    // used when the search is not parallelised, it works on the main table
+    Worker ponderWorker;
+    std::vector<std::thread> ponderThreads;
+    std::atomic<bool> ponderInterrupt;
 };
 
 #endif // MCTS_H
@@ -8,7 +8,15 @@
 #include "engine/bot/scheduler/stopscheduler.h"
 #include "engine/bot/mcts/hashtable/rzhashtable.h"
 #include "engine/bot/mcts/hashtable/zhashtable.h"
+#include "engine/bot/mcts/hashtable/crzhashtable.h"
+#include "engine/bot/mcts/hashtable/irzhashtable.h"
+#include "engine/bot/mcts/hashtable/bzhashtable.h"
+#include "engine/bot/mcts/hashtable/tablesize.h"
+#include "engine/bot/mcts/affinity/affinity.h"
 #include "mcts.h"
+#include "rootparallelmcts.h"
+#include "leafparallelmcts.h"
+#include "distributedmcts.h"
 #include "engine/bot/mcts/policy/mast.h"
 #include "engine/bot/mcts/policy/random.h"
 #include "engine/bot/mcts/exploration/uctnode.h"
@@ -18,7 +26,19 @@ class MCTSBot: public AiBotBase
 {
 public:
     template<typename G>
-    MCTSBot(G& game, std::string node, std::string policy, bool recycling, unsigned budget);
+    // address: listening address of the coordinator in the distributed search, unix:<path> or tcp:[<host>:]<port>
+    // affinity: CPUs of the tree parallel search threads, "auto" or a CPU list like "0,2,8-11" (see Affinity)
+    // node: "UCT-2", "RAVE" or "RAVE-sparse" (RAVE storing only the AMAF statistics of the played moves),
+    // "UCT-2-compact" and "RAVE-compact" store float means and 32 bit counts
+    // "UCT-2-edges" and "RAVE-edges" cache the indices of their children in the standard, recycling and bucket tables
+    // memory: table layout, empty for the default tables, "inline" for nodes stored in the entries of the recycling table
+    // "bucket" for the non-recycling table with cache line sized buckets holding about budget nodes
+    // or "huge" for the default tables with their entries and nodes mapped on huge pages when the system supports them
+    // budget: maximum number of nodes in the table, with or without recycling
+    // memoryBudget: bytes of all the tables, when it is not 0 the node budget is the largest one fitting into it
+    // with the node type and memory layout, and budget is ignored
+    // maxLoadFactor: the tables are the smallest ones keeping the ratio of nodes and node capacity at most this
+    MCTSBot(G& game, std::string node, std::string policy, bool recycling, unsigned budget, unsigned threadNum=1, std::string parallelisation="tree", bool pondering=false, std::string address="", std::string affinity="", std::string memory="", size_t memoryBudget=0, double maxLoadFactor=0.5);
 
     ~MCTSBot() { delete impl; }
 
@@ -33,8 +53,31 @@ public:
         impl->stop();
     }
 
+    // incremental search on the calling thread, the caller runs the search steps until one of them returns true
+    // then finishSearch updates the game by the best move(s). Time left should be set before startSearch
+    bool startSearch(){
+        return impl->startSearch();
+    }
+    bool searchStep(unsigned iterationNum){
+        return impl->searchStep(iterationNum);
+    }
+    void finishSearch(){
+        impl->finishSearch();
+    }
+
+    // sizes of the tables
+    unsigned getNodeBudget() const { return nodeBudget; }
+    size_t getTableBytes() const { return tableBytes; }
+    double getLoadFactor() const { return loadFactor; }
+
 private:
     MCTSBase* impl;
+    // node budget of a table, memory of all the tables and ratio of nodes and node capacity
+    unsigned nodeBudget;
+    size_t tableBytes;
+    double loadFactor;
+    // keep searching while the opponent is thinking
+    const bool pondering;
 };
 
 // helper macro to prevent code duplication caused by runtime dependent typedefs
@@ -42,68 +85,191 @@ private:
     typedef P<G> PP;                                                                            \
     typedef N<G, PP> NN;                                                                        \
     typedef T<NN> TT;                                                                           \
-    typedef StopScheduler<G, TT> S;                                                             \
-    PP* policyp = new PP(game);                                                                 \
-    NN::setup(&game, policyp);                                                                  \
-    TT* table;                                                                                  \
-    if constexpr(std::is_same_v<RZHashTable<NN>, T<NN>>)                                        \
-        table = new TT(game.getTotalValidMoveNum(), game.getMaxTurnNum(), 20, budget);          \
+    unsigned hashCodeSize = 0;                                                                  \
+    /* node sizes depend on the game, so the nodes are set up before the tables are sized */    \
+    auto sizeTables = [&](unsigned tableNum){                                                   \
+        if(memoryBudget){                                                                       \
+            TableSize size = fitBytes<TT>(memoryBudget / tableNum, game.getTotalValidMoveNum(), \
+                                          maxLoadFactor);                                       \
+            if(!size.budget)                                                                    \
+                throw std::invalid_argument( "Memory budget is too small for the tables" );     \
+            budget = size.budget;                                                               \
+            hashCodeSize = size.hashCodeSize;                                                   \
+        }                                                                                       \
+        else                                                                                    \
+            hashCodeSize = fitHashCodeSize<TT>(budget, game.getTotalValidMoveNum(),             \
+                                               maxLoadFactor);                                  \
+        nodeBudget = budget;                                                                    \
+        tableBytes = tableNum * TT::bytes(hashCodeSize, budget);                                \
+        loadFactor = double(budget) / TT::nodeCapacity(hashCodeSize);                           \
+    };                                                                                          \
+    auto createTable = [&]() -> TT* {                                                           \
+        if constexpr(std::is_same_v<CRZHashTable<NN>, T<NN>>)                                   \
+            return new TT(game.getTotalValidMoveNum(), game.getMaxTurnNum(), hashCodeSize,      \
+                          budget, affinityMap.getNodeCpus(threadNum));                          \
+        else if constexpr(std::is_same_v<RZHashTable<NN>, T<NN>> ||                             \
+                          std::is_same_v<ZHashTable<NN>, T<NN>>)                                \
+            return new TT(game.getTotalValidMoveNum(), game.getMaxTurnNum(), hashCodeSize,      \
+                          budget, memory == "huge");                                            \
+        else                                                                                    \
+            return new TT(game.getTotalValidMoveNum(), game.getMaxTurnNum(), hashCodeSize,      \
+                          budget);                                                              \
+    };                                                                                          \
+    if(parallelisation == "root"){                                                              \
+        typedef StopScheduler<G, RootStatistics> S;                                             \
+        NN::setup(&game, nullptr);                                                              \
+        sizeTables(threadNum);                                                                  \
+        std::vector<TT*> tables;                                                                \
+        for(unsigned i = 0; i < threadNum; ++i)                                                 \
+            tables.push_back(createTable());                                                    \
+        RootStatistics* stats = new RootStatistics(game.getTotalValidMoveNum());                \
+        S* scheduler = new S(timeLeft, game, *stats);                                           \
+        impl = new RootParallelMCTS<NN, G, TT, PP, S>(game, tables, stats, scheduler);          \
+    }                                                                                           \
+    else if(parallelisation == "distributed"){                                                  \
+        typedef StopScheduler<G, RootStatistics> S;                                             \
+        NN::setup(&game, nullptr);                                                              \
+        sizeTables(1);                                                                          \
+        Coordinator* coordinator = new Coordinator(address, {game.getBoardSize(), node, policy, \
+                                                   recycling, budget, 4, 20});                  \
+        RootStatistics* stats = new RootStatistics(game.getTotalValidMoveNum());                \
+        S* scheduler = new S(timeLeft, game, *stats);                                           \
+        impl = new DistributedMCTS<NN, G, TT, PP, S>(game, createTable(), stats, scheduler,     \
+                                                     coordinator);                              \
+    }                                                                                           \
+    else{                                                                                       \
+        typedef StopScheduler<G, TT> S;                                                         \
+        PP* policyp = new PP(game);                                                             \
+        NN::setup(&game, policyp);                                                              \
+        sizeTables(1);                                                                          \
+        TT* table = createTable();                                                              \
+        S* scheduler = new S(timeLeft, game, *table);                                           \
+        Affinity* affinityp = nullptr;                                                          \
+        if(parallelisation == "tree" && threadNum > 1 && !affinityMap.empty())                  \
+            affinityp = new Affinity(affinityMap);                                              \
+        if(parallelisation == "leaf")                                                           \
+            impl = new LeafParallelMCTS<NN, G, TT, PP, S>(game, table, policyp, scheduler,      \
+                                                          threadNum);                           \
+        else                                                                                    \
+            impl = new MCTS<NN, G, TT, PP, S>(game, table, policyp, scheduler, threadNum,       \
+                                              affinityp);                                       \
+    }                                                                                           \
+
+// runtime dispatch on node and policy types with a given hashtable
+#define CREATE_IMPLS(T)                                                                         \
+    if(node == "UCT-2"){                                                                        \
+        if(policy == "random"){                                                                 \
+            CREATE_IMPL(UCTNode, T, RandomPolicy)                                               \
+        }                                                                                       \
+        else if(policy == "MAST"){                                                              \
+            CREATE_IMPL(UCTNode, T, MAST)                                                       \
+        }                                                                                       \
+        else                                                                                    \
+            throw std::invalid_argument( "Invalid policy string: " + policy + " received" );    \
+    }                                                                                           \
+    else if(node == "UCT-2-compact"){                                                           \
+        if(policy == "random"){                                                                 \
+            CREATE_IMPL(CompactUCTNode, T, RandomPolicy)                                        \
+        }                                                                                       \
+        else if(policy == "MAST"){                                                              \
+            CREATE_IMPL(CompactUCTNode, T, MAST)                                                \
+        }                                                                                       \
+        else                                                                                    \
+            throw std::invalid_argument( "Invalid policy string: " + policy + " received" );    \
+    }                                                                                           \
+    else if(node == "UCT-2-edges"){                                                             \
+        if(policy == "random"){                                                                 \
+            CREATE_IMPL(EdgeUCTNode, T, RandomPolicy)                                           \
+        }                                                                                       \
+        else if(policy == "MAST"){                                                              \
+            CREATE_IMPL(EdgeUCTNode, T, MAST)                                                   \
+        }                                                                                       \
+        else                                                                                    \
+            throw std::invalid_argument( "Invalid policy string: " + policy + " received" );    \
+    }                                                                                           \
+    else if(node == "RAVE"){                                                                    \
+        if(policy == "random"){                                                                 \
+            CREATE_IMPL(RAVENode, T, RandomPolicy)                                              \
+        }                                                                                       \
+        else if(policy == "MAST"){                                                              \
+            CREATE_IMPL(RAVENode, T, MAST)                                                      \
+        }                                                                                       \
+        else                                                                                    \
+            throw std::invalid_argument( "Invalid policy string: " + policy + " received" );    \
+    }                                                                                           \
+    else if(node == "RAVE-compact"){                                                            \
+        if(policy == "random"){                                                                 \
+            CREATE_IMPL(CompactRAVENode, T, RandomPolicy)                                       \
+        }                                                                                       \
+        else if(policy == "MAST"){                                                              \
+            CREATE_IMPL(CompactRAVENode, T, MAST)                                               \
+        }                                                                                       \
+        else                                                                                    \
+            throw std::invalid_argument( "Invalid policy string: " + policy + " received" );    \
+    }                                                                                           \
+    else if(node == "RAVE-edges"){                                                              \
+        if(policy == "random"){                                                                 \
+            CREATE_IMPL(EdgeRAVENode, T, RandomPolicy)                                          \
+        }                                                                                       \
+        else if(policy == "MAST"){                                                              \
+            CREATE_IMPL(EdgeRAVENode, T, MAST)                                                  \
+        }                                                                                       \
+        else                                                                                    \
+            throw std::invalid_argument( "Invalid policy string: " + policy + " received" );    \
+    }                                                                                           \
+    else if(node == "RAVE-sparse"){                                                             \
+        if(policy == "random"){                                                                 \
+            CREATE_IMPL(SparseRAVENode, T, RandomPolicy)                                        \
+        }                                                                                       \
+        else if(policy == "MAST"){                                                              \
+            CREATE_IMPL(SparseRAVENode, T, MAST)                                                \
+        }                                                                                       \
+        else                                                                                    \
+            throw std::invalid_argument( "Invalid policy string: " + policy + " received" );    \
+    }                                                                                           \
     else                                                                                        \
-        table = new TT(game.getTotalValidMoveNum(), game.getMaxTurnNum(),20);                   \
-    S* scheduler = new S(timeLeft, game, *table);                                               \
-    impl = new MCTS<NN, G, TT, PP, S>(game, table, policyp, scheduler);                         \
+        throw std::invalid_argument( "Invalid node string: " + node + " received" );            \
 
 template<typename G>
-MCTSBot::MCTSBot(G& game, std::string node, std::string policy, bool recycling, unsigned budget)
+MCTSBot::MCTSBot(G& game, std::string node, std::string policy, bool recycling, unsigned budget, unsigned threadNum, std::string parallelisation, bool pondering, std::string address, std::string affinity, std::string memory, size_t memoryBudget, double maxLoadFactor):
+    pondering(pondering)
 {
     try{
-        if(recycling){
-            if(node == "UCT-2"){
-                if(policy == "random"){
-                    CREATE_IMPL(UCTNode, RZHashTable, RandomPolicy)
-                }
-                else if(policy == "MAST"){
-                    CREATE_IMPL(UCTNode, RZHashTable, MAST)
-                }
-                else
-                    throw std::invalid_argument( "Invalid node string: " + node + " received" );
-            }
-            else if(node == "RAVE"){
-                if(policy == "random"){
-                    CREATE_IMPL(RAVENode, RZHashTable, RandomPolicy)
-                }
-                else if(policy == "MAST"){
-                    CREATE_IMPL(RAVENode, RZHashTable, MAST)
-                }
-                else
-                    throw std::invalid_argument( "Invalid node string: " + node + " received" );
-            }
-            else
-                throw std::invalid_argument( "Invalid policy string: " + policy + " received" );
+        if(threadNum == 0)
+            throw std::invalid_argument( "Invalid number of threads: 0 received" );
+        if(!(maxLoadFactor > 0 && maxLoadFactor <= 1))
+            throw std::invalid_argument( "Invalid load factor: " + std::to_string(maxLoadFactor) + " received" );
+        // tree: threads share a single tree, root: each thread searches its own tree,
+        // leaf: threads run a batch of playouts from the same leaf
+        // distributed: worker processes search their own trees, the local tree is searched on a single thread
+        if(parallelisation != "tree" && parallelisation != "root" && parallelisation != "leaf" && parallelisation != "distributed")
+            throw std::invalid_argument( "Invalid parallelisation string: " + parallelisation + " received" );
+        // only the threads of the tree parallel search are pinned, the shards of its concurrent table
+        // are spread over the NUMA nodes of the pinned threads
+        const Affinity affinityMap(affinity);
+        if(memory != "" && memory != "inline" && memory != "bucket" && memory != "huge")
+            throw std::invalid_argument( "Invalid memory string: " + memory + " received" );
+        if(memory == "inline"){
+            if(!recycling)
+                throw std::invalid_argument( "Inline table is only available with recycling" );
+            CREATE_IMPLS(IRZHashTable)
+        }
+        else if(memory == "bucket"){
+            if(recycling)
+                throw std::invalid_argument( "Bucket table has its own replacement scheme, it is only available without recycling" );
+            CREATE_IMPLS(BZHashTable)
+        }
+        // threads of the tree parallel search share the table of the recycling variant without locking it
+        else if(recycling && threadNum > 1 && parallelisation == "tree"){
+            if(memory == "huge")
+                throw std::invalid_argument( "Huge page table is not available for the tree parallel search with recycling" );
+            CREATE_IMPLS(CRZHashTable)
+        }
+        else if(recycling){
+            CREATE_IMPLS(RZHashTable)
         }
         else{
-            if(node == "UCT-2"){
-                if(policy == "random"){
-                    CREATE_IMPL(UCTNode, ZHashTable, RandomPolicy)
-                }
-                else if(policy == "MAST"){
-                    CREATE_IMPL(UCTNode, ZHashTable, MAST)
-                }
-                else
-                    throw std::invalid_argument( "Invalid node string: " + node + " received" );
-            }
-            else if(node == "RAVE"){
-                if(policy == "random"){
-                    CREATE_IMPL(RAVENode, ZHashTable, RandomPolicy)
-                }
-                else if(policy == "MAST"){
-                    CREATE_IMPL(RAVENode, ZHashTable, MAST)
-                }
-                else
-                    throw std::invalid_argument( "Invalid node string: " + node + " received" );
-            }
-            else
-                throw std::invalid_argument( "Invalid policy string: " + policy + " received" );
+            CREATE_IMPLS(ZHashTable)
         }
     }
     catch(std::bad_alloc& e){
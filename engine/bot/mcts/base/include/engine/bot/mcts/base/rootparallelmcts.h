@@ -0,0 +1,159 @@
+#ifndef ROOTPARALLELMCTS_H
+#define ROOTPARALLELMCTS_H
+
+#include "mcts.h"
+#include "rootstatistics.h"
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+/**********************************************************************************
+ * Root parallelisation                                                           *
+ * - Independent trees (each with its own table, policy and game) are searched    *
+ * on separate threads so there is no synchronization during the search phase    *
+ * - Trees publish the statistics of their root children after each cycle.        *
+ * The scheduler and the final move selection use the merged statistics: visit   *
+ * counts are summed and state scores are averaged weighted by the visit counts   *
+ **********************************************************************************/
+
+// node, game, hashtable, policy, scheduler inspecting RootStatistics
+template<typename N, typename G, typename T, typename P, typename S>
+class RootParallelMCTS: public MCTSBase
+{
+public:
+    typedef MCTS<N, G, T, P, S> Tree;
+
+    // a tree is built on each table with its own game and policy
+    RootParallelMCTS(G& game, const std::vector<T*>& tables, RootStatistics* stats, S* scheduler):
+        game(game),
+        stats(stats),
+        scheduler(scheduler),
+        nextTree(0)
+    {
+        games.reserve(tables.size());
+        trees.reserve(tables.size());
+        for(auto table : tables){
+            G* treeGame = game.clone();
+            games.push_back(treeGame);
+            // trees are driven by this instance so they do not need a scheduler
+            trees.push_back(new Tree(*treeGame, table, new P(*treeGame), nullptr));
+        }
+    }
+
+    RootParallelMCTS(const RootParallelMCTS&)=delete;
+    RootParallelMCTS& operator=(const RootParallelMCTS&)=delete;
+    RootParallelMCTS(RootParallelMCTS&&)=delete;
+    RootParallelMCTS& operator=(RootParallelMCTS&&)=delete;
+
+    virtual ~RootParallelMCTS(){
+        // trees stop pondering before their games are deleted
+        for(auto tree : trees)
+            delete tree;
+        for(auto treeGame : games)
+            delete treeGame;
+        delete scheduler;
+        delete stats;
+    }
+
+    virtual void updateByOpponent(unsigned int moveIdx) final{
+        for(auto tree : trees)
+            tree->updateByOpponent(moveIdx);
+    }
+
+    virtual void run() override{
+        bool finished = startSearch();
+        if(!finished){
+            done.store(false);
+            std::vector<std::thread> threads;
+            threads.reserve(trees.size());
+            for(unsigned treeIdx = 0; treeIdx < trees.size(); ++treeIdx)
+                threads.emplace_back(&RootParallelMCTS::search, this, treeIdx);
+            for(auto& thread : threads)
+                thread.join();
+            finished = done.load();
+        }
+        if(finished)
+            finishSearch();
+    }
+
+    virtual bool startSearch() override{
+        stopPondering();
+        // game is only used to list the root children, it stays at the root during the search
+        game.selectRoot();
+        stats->setRoot(game, trees);
+        scheduler->schedule();
+        interrupt.store(false);
+        nextTree = 0;
+        return scheduler->finish();
+    }
+
+    // trees are iterated in turn on the calling thread
+    virtual bool searchStep(unsigned iterationNum) override{
+        for(unsigned i = 0; i < iterationNum; ++i){
+            trees[nextTree]->iterate();
+            stats->publish(nextTree, *trees[nextTree]);
+            nextTree = (nextTree + 1) % trees.size();
+            if(scheduler->finish())
+                return true;
+        }
+        return false;
+    }
+
+    virtual void finishSearch() override{
+        unsigned rootPlayer = game.getNextPlayer();
+        unsigned currPlayer;
+        // update root by the best move according to the merged statistics
+        do{
+            unsigned bestMoveIdx = Node::mostVisited(stats, &game);
+            game.update(bestMoveIdx);
+            for(auto tree : trees)
+                tree->updateByOpponent(bestMoveIdx);
+            stats->setRoot(game, trees);
+            currPlayer = game.getNextPlayer();
+        }while(rootPlayer == currPlayer); // one player might have multiple moves in a turn
+    }
+
+    virtual void stop() override{
+        interrupt.store(true);
+    }
+
+    virtual void startPondering() override{
+        for(auto tree : trees)
+            tree->startPondering();
+    }
+
+    virtual void stopPondering() override{
+        for(auto tree : trees)
+            tree->stopPondering();
+    }
+
+protected:
+    void search(unsigned treeIdx){
+        Tree& tree = *trees[treeIdx];
+        while(!interrupt.load() && !done.load()){
+            tree.iterate();
+            std::lock_guard<std::mutex> lock(mutex);
+            stats->publish(treeIdx, tree);
+            if(scheduler->finish())
+                done.store(true);
+        }
+    }
+
+    G& game;
+    std::vector<G*> games;
+    std::vector<Tree*> trees;
+    RootStatistics* const stats;
+    S* const scheduler;
+
+    std::atomic<bool> interrupt;
+    // guards the published statistics and the scheduler
+    std::mutex mutex;
+    // set by the thread whose scheduler check finished the search
+    std::atomic<bool> done;
+    // tree to iterate next in the incremental search
+    unsigned nextTree;
+};
+
+#endif // ROOTPARALLELMCTS_H
@@ -0,0 +1,85 @@
+#ifndef ROOTSTATISTICS_H
+#define ROOTSTATISTICS_H
+
+#include <vector>
+
+/**********************************************************************************
+ * Merged statistics of the root children from independent search trees          *
+ * (root parallelisation). It provides the same select interface for the root     *
+ * children as the hashtables so it can be inspected by the schedulers and by     *
+ * Node::mostVisited                                                              *
+ **********************************************************************************/
+
+class RootStatistics
+{
+public:
+    struct Stats{
+        double visitCount;
+        double stateScore;
+
+        double getVisitCount() const { return visitCount; }
+        double getStateScore() const { return stateScore; }
+    };
+
+    RootStatistics(unsigned moveNum);
+
+    RootStatistics(const RootStatistics&)=delete;
+    RootStatistics& operator=(const RootStatistics&)=delete;
+    RootStatistics(RootStatistics&&)=delete;
+    RootStatistics& operator=(RootStatistics&&)=delete;
+
+    // set the root children from the valid moves of the game and publish the statistics of each tree
+    template<typename G, typename M>
+    void setRoot(G& game, const std::vector<M*>& trees);
+    // copy the statistics of the root children from a tree, the tree should not be searched meanwhile
+    template<typename M>
+    void publish(unsigned treeIdx, const M& tree);
+
+    // sources other than the trees (like the trees of other processes) publish child by child, their
+    // indices follow the ones of the trees. Their statistics are dropped when the root is set
+    void clear(unsigned sourceIdx);
+    // moves that are not root children are ignored
+    void publish(unsigned sourceIdx, unsigned moveIdx, double visitCount, double stateScore);
+
+    // merged statistics of a root child, nullptr when none of the trees explored it
+    const Stats* select(unsigned moveIdx);
+
+protected:
+    // root children
+    std::vector<unsigned> moveIdxs;
+    // moveIdx -> index in moveIdxs
+    std::vector<unsigned> lookup;
+    // [source][child] -> statistics published by the tree
+    std::vector<std::vector<Stats>> published;
+    // moveIdx -> merged statistics
+    std::vector<Stats> merged;
+};
+
+template<typename G, typename M>
+void RootStatistics::setRoot(G& game, const std::vector<M*>& trees){
+    moveIdxs.clear();
+    for(const auto& move : game.getValidMoves()){
+        unsigned moveIdx = game.toMoveIdx(move.getPiece(), move.getPos());
+        lookup[moveIdx] = moveIdxs.size();
+        moveIdxs.push_back(moveIdx);
+    }
+    published.resize(trees.size());
+    for(unsigned treeIdx = 0; treeIdx < trees.size(); ++treeIdx){
+        published[treeIdx].resize(moveIdxs.size());
+        publish(treeIdx, *trees[treeIdx]);
+    }
+}
+
+template<typename M>
+void RootStatistics::publish(unsigned treeIdx, const M& tree){
+    auto& stats = published[treeIdx];
+    for(unsigned idx = 0; idx < moveIdxs.size(); ++idx){
+        auto child = tree.selectRootChild(moveIdxs[idx]);
+        if(child)
+            stats[idx] = {child->getVisitCount(), child->getStateScore()};
+        else
+            stats[idx] = {0, 0};
+    }
+}
+
+#endif // ROOTSTATISTICS_H
@@ -4,8 +4,13 @@
 
 void MCTSBot::updateGame(){
     impl->run();
+    if(pondering)
+        impl->startPondering();
 }
 
 void MCTSBot::updateByOpponent(unsigned int moveIdx){
+    // pondering is stopped before the root is updated so the search continues from the selected child
     impl->updateByOpponent(moveIdx);
+    if(pondering)
+        impl->startPondering();
 }
@@ -0,0 +1,41 @@
+#include "rootstatistics.h"
+
+RootStatistics::RootStatistics(unsigned moveNum):
+    lookup(moveNum, 0),
+    merged(moveNum, {0, 0})
+{
+    moveIdxs.reserve(moveNum);
+}
+
+const RootStatistics::Stats* RootStatistics::select(unsigned moveIdx){
+    unsigned idx = lookup[moveIdx];
+    double visitCount = 0;
+    double score = 0;
+    for(const auto& stats : published){
+        visitCount += stats[idx].visitCount;
+        score += stats[idx].visitCount * stats[idx].stateScore;
+    }
+    if(visitCount == 0)
+        return nullptr;
+    merged[moveIdx] = {visitCount, score / visitCount};
+    return &merged[moveIdx];
+}
+
+void RootStatistics::clear(unsigned sourceIdx){
+    // sources in between are cleared as well
+    if(sourceIdx >= published.size())
+        published.resize(sourceIdx + 1, std::vector<Stats>(moveIdxs.size(), {0, 0}));
+    else
+        published[sourceIdx].assign(moveIdxs.size(), {0, 0});
+}
+
+void RootStatistics::publish(unsigned sourceIdx, unsigned moveIdx, double visitCount, double stateScore){
+    if(moveIdx >= lookup.size())
+        return;
+    unsigned idx = lookup[moveIdx];
+    if(idx >= moveIdxs.size() || moveIdxs[idx] != moveIdx)
+        return;
+    if(sourceIdx >= published.size())
+        clear(sourceIdx);
+    published[sourceIdx][idx] = {visitCount, stateScore};
+}
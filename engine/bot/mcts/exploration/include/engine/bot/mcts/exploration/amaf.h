@@ -0,0 +1,135 @@
+#ifndef AMAF_H
+#define AMAF_H
+
+#include "statistics.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+/**********************************************************************************
+ * AMAF layouts of RAVENode                                                       *
+ * The AMAF statistics of a node are stored in a fixed-size slice of the arena of *
+ * the table (see NodeArena). A layout defines the slice and how the statistics   *
+ * of a move are found in it:                                                     *
+ *   typedef slice_type: trivial type of the slice elements                       *
+ *   static unsigned sliceSize(unsigned moveNum): number of elements in a slice   *
+ *   static void clear(slice_type* slice, unsigned size): initial statistics      *
+ *   static double mean(const slice_type* slice, unsigned size, unsigned moveIdx) *
+ *   static void update(slice_type* slice, unsigned size, unsigned moveIdx,       *
+ *                      double val)                                               *
+ * Moves without statistics have the prior mean 0.5 weighted by a single sample   *
+ * The number types of the statistics are given by S (see statistics.h), they are *
+ * used for the MC statistics of the node as well (typedef stats)                 *
+ * Layouts with edges (S::edges) store the index of the child node of the moves   *
+ * (see RAVENode):                                                                *
+ *   static uint32_t& edge(slice_type* slice, unsigned moveIdx)                   *
+ **********************************************************************************/
+
+// statistics of every move, indexed by the move
+template<typename S=DoubleStats>
+struct DenseAMAF
+{
+    typedef S stats;
+
+    struct Entry{
+        typename S::mean_type mean;
+        typename S::count_type count;
+    };
+    struct EdgeEntry{
+        typename S::mean_type mean;
+        typename S::count_type count;
+        // index of the child node in the table
+        uint32_t edge;
+    };
+    typedef std::conditional_t<S::edges, EdgeEntry, Entry> slice_type;
+
+    static unsigned sliceSize(unsigned moveNum){
+        return moveNum;
+    }
+
+    static void clear(slice_type* slice, unsigned size){
+        std::fill(slice, slice + size, slice_type{0.5, 1});
+    }
+
+    static double mean(const slice_type* slice, unsigned, unsigned moveIdx){
+        return slice[moveIdx].mean;
+    }
+
+    static void update(slice_type* slice, unsigned, unsigned moveIdx, double val){
+        slice_type& entry = slice[moveIdx];
+        entry.mean = (double(entry.mean) * entry.count + val) / (entry.count + 1);
+        ++entry.count;
+    }
+
+    static uint32_t& edge(EdgeEntry* slice, unsigned moveIdx){
+        return slice[moveIdx].edge;
+    }
+};
+
+/**********************************************************************************
+ * Sparse AMAF layout                                                             *
+ * - Only the moves that were played after the node are stored in a small open-   *
+ * addressed map (linear probing) with entries for 1/fraction of the moves        *
+ * - When the map is full the statistics of new moves are not stored, they keep   *
+ * the prior. Nodes visited by a lot of different playouts (close to the root)    *
+ * lose some AMAF information in exchange for the smaller nodes                   *
+ * - Lookups are slower than the direct indexing of the dense layout              *
+ **********************************************************************************/
+
+template<unsigned fraction=2, typename S=DoubleStats>
+struct SparseAMAF
+{
+    static_assert(fraction > 0, "SparseAMAF: fraction should be positive");
+    static_assert(!S::edges, "SparseAMAF: moves without an entry have no edge");
+
+    typedef S stats;
+
+    // counts are whole numbers, they share the 8 bytes of the key
+    struct Entry{
+        unsigned moveIdx;
+        uint32_t count;
+        typename S::mean_type mean;
+    };
+    typedef Entry slice_type;
+
+    static constexpr unsigned EMPTY = ~0u;
+
+    static unsigned sliceSize(unsigned moveNum){
+        return std::max(1u, (moveNum + fraction - 1) / fraction);
+    }
+
+    static void clear(Entry* slice, unsigned size){
+        std::fill(slice, slice + size, Entry{EMPTY, 1, 0.5});
+    }
+
+    // entry of the move or the empty entry where it can be inserted, nullptr when it is not found in a full map
+    template<typename E>
+    static E* find(E* slice, unsigned size, unsigned moveIdx){
+        unsigned idx = moveIdx % size;
+        for(unsigned steps = 0; steps < size; ++steps){
+            if(slice[idx].moveIdx == moveIdx || slice[idx].moveIdx == EMPTY)
+                return slice + idx;
+            if(++idx == size)
+                idx = 0;
+        }
+        return nullptr;
+    }
+
+    static double mean(const Entry* slice, unsigned size, unsigned moveIdx){
+        // empty entries hold the prior
+        const Entry* entry = find(slice, size, moveIdx);
+        return entry ? entry->mean : 0.5;
+    }
+
+    static void update(Entry* slice, unsigned size, unsigned moveIdx, double val){
+        Entry* entry = find(slice, size, moveIdx);
+        if(!entry)
+            return;
+        entry->moveIdx = moveIdx;
+        entry->mean = (double(entry->mean) * entry->count + val) / (entry->count + 1);
+        ++entry->count;
+    }
+};
+
+#endif // AMAF_H
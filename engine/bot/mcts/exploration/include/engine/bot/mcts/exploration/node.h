@@ -15,26 +15,35 @@ protected:
     Node& operator=(Node&&)=delete;
 
 public:
+    // T only needs to provide select for the children statistics of the root so merged statistics
+    // of several trees can be used as well
+    template<typename T, typename G>
+    static unsigned mostVisited(T* const table, G* game);
+
     template<template<typename> typename T, typename N, typename G>
     static N* selectMostVisited(T<N>* const table, G* game);
 };
 
-template<template<typename> typename T, typename N, typename G>
-N* Node::selectMostVisited(T<N>* const  table, G* game){
+template<typename T, typename G>
+unsigned Node::mostVisited(T* const table, G* game){
     double maxVisit = -1;
     unsigned int bestMoveIdx;
-    N* bestChild;
     for(const auto& move : game->getValidMoves()){
         unsigned moveIdx = game->toMoveIdx(move.getPiece(), move.getPos());
-        N* child = table->select(moveIdx);
+        auto child = table->select(moveIdx);
         double visit = child ? child->getVisitCount() : 0;
         if(visit > maxVisit){
             maxVisit = visit;
-            bestChild = child;
             bestMoveIdx = moveIdx;
         }
     }
-    bestChild = table->updateRoot(bestMoveIdx);
+    return bestMoveIdx;
+}
+
+template<template<typename> typename T, typename N, typename G>
+N* Node::selectMostVisited(T<N>* const  table, G* game){
+    unsigned bestMoveIdx = mostVisited(table, game);
+    N* bestChild = table->updateRoot(bestMoveIdx);
     game->update(bestMoveIdx);
     return bestChild;
 }
@@ -1,6 +1,9 @@
 #ifndef RAVENODE_H
 #define RAVENODE_H
 
+#include "amaf.h"
+#include "selectionkernel.h"
+
 #include <vector>
 #include <array>
 
@@ -26,9 +29,16 @@
  * However, policy and game types should be made as class templates because these *
  * objects are used in the constructor and reset function, which is called from   *
  * the hashtable classes. Hashtable should not know about game and policy types   *
+ *                                                                                *
+ * The layout of the AMAF statistics is given by A (see amaf.h), its number types *
+ * are used for the MC statistics as well. Layouts with edges cache the indices   *
+ * of the child nodes, so the tables supporting them are not probed for the       *
+ * children that are already in the table                                         *
+ *                                                                                *
+ * Children are scored by the selection kernel (see selectionkernel.h)            *
  **********************************************************************************/
 
-template<typename G, typename P>
+template<typename G, typename P, typename A=DenseAMAF<>>
 class RAVENode
 {
 public:
@@ -44,31 +54,50 @@ public:
 
     void reset();
 
+    // ---- AMAF statistics in the arena of the table (see NodeArena) ----
+    typedef typename A::slice_type slice_type;
+    static unsigned sliceSize();
+    void bind(unsigned slice);
+    unsigned getSlice() const;
+
+    // weight is the number of playouts aggregated in a single search cycle (leaf parallelisation)
+    // visit counts are only updated during backpropagation so selection and expansion ignore it
     template<template<typename> typename T>
-    RAVENode<G, P>* select(T<RAVENode<G, P>>* const table);
+    RAVENode<G, P, A>* select(T<RAVENode<G, P, A>>* const table, unsigned weight=1);
 
     template<template<typename> typename T>
-    RAVENode<G, P>* expand(T<RAVENode<G, P>>* const table);
+    RAVENode<G, P, A>* expand(T<RAVENode<G, P, A>>* const table, unsigned weight=1);
 
+    // outcome is the mean outcome of the aggregated playouts
     template<template<typename> typename T>
-    void backprop(double outcome, T<RAVENode<G, P>>* const table, unsigned leafDepth);
+    void backprop(double outcome, T<RAVENode<G, P, A>>* const table, unsigned leafDepth, unsigned weight=1);
 
     // getters
     double getStateScore() const;
     double getVisitCount() const;
+    // memory of a node including its AMAF statistics
+    static size_t getNodeBytes();
 protected:
 
-    inline void updateMC(double val);
-    inline void updateRAVE(double outcome, const std::array<std::vector<unsigned>, 2>& takenMoves);
+    inline void updateMC(double val, unsigned weight);
+    inline void updateRAVE(slice_type* amaf, double outcome, const std::array<std::vector<unsigned>, 2>& takenMoves);
+
+    // MC mean of a child in its score
+    static inline double childMean(const RAVENode<G, P, A>* child);
 
-    inline double actionScore(RAVENode<G, P>* child, double beta, unsigned idx) const;
+    // AMAF statistics of the node, they are initialized at the first update after a reset
+    template<template<typename> typename T>
+    inline slice_type* getAMAF(T<RAVENode<G, P, A>>* const table);
+    // read only access, the initial values are used until the first update
+    template<template<typename> typename T>
+    inline const slice_type* readAMAF(T<RAVENode<G, P, A>>* const table) const;
 
     // k value for weigthing MC and AMAF values
     static constexpr double k = 1000;
 
     // MC values are stored at the child nodes so they get more samples
-    double mcMean;
-    double mcCount;
+    typename A::stats::mean_type mcMean;
+    typename A::stats::count_type mcCount;
 
     // AMAF values are stored at the parent to spare memory
     /**
@@ -77,107 +106,176 @@ protected:
      * played later on. If we stored only the valid moves then the same moves
      * might be indexed differently for different nodes
     **/
-    // [piece][pos]
-    std::vector<double> rMean;
-    std::vector<double> rCount;
+    // [piece][pos], a slice of the arena of the table
+    unsigned slice;
+    // the slice is not initialized since the last reset
+    bool fresh;
+
+    // number of search threads currently passing through the node (virtual loss)
+    unsigned vLoss;
 
-    inline static P* policy;
-    inline static G* game;
+    // set separately for each search thread as they work on their own game and policy instances
+    // engines set them at each entry point so several engines can be used from the same thread
+    inline static thread_local P* policy;
+    inline static thread_local G* game;
+    // initial AMAF statistics, its size is the size of the slices
+    inline static thread_local std::vector<slice_type> initial;
+    // moves of the players played after the current node during backpropagation, reserved for a whole game
+    inline static thread_local std::array<std::vector<unsigned>, 2> takenMoves;
+    // children of the node being selected
+    inline static thread_local ChildBatch<RAVENode<G, P, A>> batch;
 };
 
-template<typename G, typename P>
-void RAVENode<G, P>::setup(G* game, P* policy)
+template<typename G, typename P, typename A>
+void RAVENode<G, P, A>::setup(G* game, P* policy)
 {
-    RAVENode<G, P>::game = game;
-    RAVENode<G, P>::policy = policy;
+    RAVENode<G, P, A>::game = game;
+    RAVENode<G, P, A>::policy = policy;
+    if(initial.size() != sliceSize()){
+        initial.resize(sliceSize());
+        A::clear(initial.data(), initial.size());
+    }
+    for(auto& moves : takenMoves)
+        moves.reserve(game->getTotalValidMoveNum());
+    batch.resize(game->getMaxValidMoveNum());
 }
 
-template<typename G, typename P>
-void RAVENode<G, P>::reset(){
+template<typename G, typename P, typename A>
+void RAVENode<G, P, A>::reset(){
     mcCount = 1;
     mcMean = 0.5;
-    std::fill(rCount.begin(), rCount.end(), 1);
-    std::fill(rMean.begin(), rMean.end(), 0.5);
+    vLoss = 0;
+    fresh = true;
 }
 
-template<typename G, typename P>
-RAVENode<G, P>::RAVENode():
+template<typename G, typename P, typename A>
+unsigned RAVENode<G, P, A>::sliceSize(){
+    return A::sliceSize(game->getTotalValidMoveNum());
+}
+
+template<typename G, typename P, typename A>
+void RAVENode<G, P, A>::bind(unsigned slice){
+    this->slice = slice;
+    fresh = true;
+}
+
+template<typename G, typename P, typename A>
+unsigned RAVENode<G, P, A>::getSlice() const{
+    return slice;
+}
+
+template<typename G, typename P, typename A>
+template<template<typename> typename T>
+typename RAVENode<G, P, A>::slice_type* RAVENode<G, P, A>::getAMAF(T<RAVENode<G, P, A>>* const table){
+    slice_type* amaf = table->getArena().get(slice);
+    // single contiguous copy instead of clearing the statistics on every recycling
+    if(fresh){
+        std::copy(initial.begin(), initial.end(), amaf);
+        fresh = false;
+    }
+    return amaf;
+}
+
+template<typename G, typename P, typename A>
+template<template<typename> typename T>
+const typename RAVENode<G, P, A>::slice_type* RAVENode<G, P, A>::readAMAF(T<RAVENode<G, P, A>>* const table) const{
+    // selection does not write the slice so it does not race with the updates of an other thread
+    return fresh ? initial.data() : table->getArena().get(slice);
+}
+
+template<typename G, typename P, typename A>
+RAVENode<G, P, A>::RAVENode():
     mcCount(1.0),
     mcMean(0.5),
-    rCount(std::vector<double>(game->getTotalValidMoveNum(), 1)),
-    rMean(std::vector<double>(game->getTotalValidMoveNum(), 0.5))
+    vLoss(0),
+    slice(0),
+    fresh(true)
 {
 }
 
-template<typename G, typename P>
-double RAVENode<G, P>::actionScore(RAVENode<G, P>* child, double beta, unsigned idx) const {
-    return (1-beta) *
-    (child ? child->mcMean : 0.5)
-    + beta * (rMean[idx]);
+template<typename G, typename P, typename A>
+double RAVENode<G, P, A>::childMean(const RAVENode<G, P, A>* child) {
+    if(!child)
+        return 0.5;
+    // children selected by other threads are treated as if they had lost the pending playouts
+    return child->vLoss ? double(child->mcMean) * child->mcCount / (child->mcCount + child->vLoss) : child->mcMean;
 }
 
-template<typename G, typename P>
+template<typename G, typename P, typename A>
 template<template<typename> typename T>
-RAVENode<G, P>* RAVENode<G, P>::select(T<RAVENode<G, P>>* const table){
-    RAVENode<G, P>* bestChild = nullptr;
-    unsigned bestIdx;
-    unsigned bestMoveIdx;
-    double maxScore = -1;
-    double score;
-    double beta = sqrt(RAVENode<G, P>::k / (3.0 * mcCount + RAVENode<G, P>::k));
+RAVENode<G, P, A>* RAVENode<G, P, A>::select(T<RAVENode<G, P, A>>* const table, unsigned){
+    double beta = sqrt(RAVENode<G, P, A>::k / (3.0 * mcCount + RAVENode<G, P, A>::k));
+    // edges are written during the selection
+    constexpr bool edges = A::stats::edges && T<RAVENode<G, P, A>>::edges;
+    slice_type* children = nullptr;
+    if constexpr(edges)
+        children = getAMAF(table);
+    const slice_type* amaf = edges ? children : readAMAF(table);
+    // probes of the children are independent, their cache misses overlap when the entries are loaded up front
+    // thread_local statics are accessed through a wrapper call, the batch is looked up once
+    ChildBatch<RAVENode<G, P, A>>& batch = RAVENode<G, P, A>::batch;
+    unsigned moveNum = initial.size();
+    unsigned size = 0;
     for(const auto& move : game->getValidMoves()){
-        unsigned piece = move.getPiece();
-        unsigned pos = move.getPos();
-        unsigned moveIdx = game->toMoveIdx(piece, pos);
-        RAVENode<G, P>* child = table->select(moveIdx);
-        score = actionScore(child, beta, moveIdx);
-        if(score > maxScore){
-            maxScore = score;
-            bestChild = child;
-            bestMoveIdx = moveIdx;
-        }
+        unsigned moveIdx = game->toMoveIdx(move.getPiece(), move.getPos());
+        if constexpr(T<RAVENode<G, P, A>>::prefetching)
+            table->prefetch(moveIdx);
+        batch.moveIdxs[size++] = moveIdx;
+    }
+    for(unsigned idx = 0; idx < size; ++idx){
+        unsigned moveIdx = batch.moveIdxs[idx];
+        RAVENode<G, P, A>* child;
+        if constexpr(edges)
+            child = table->select(moveIdx, A::edge(children, moveIdx));
+        else
+            child = table->select(moveIdx);
+        batch.nodes[idx] = child;
+        batch.means[idx] = childMean(child);
+        batch.terms[idx] = A::mean(amaf, moveNum, moveIdx);
     }
+    unsigned bestIdx = SelectionKernel::blend(batch.means.data(), batch.terms.data(), size, beta);
+    RAVENode<G, P, A>* bestChild = batch.nodes[bestIdx];
+    unsigned bestMoveIdx = batch.moveIdxs[bestIdx];
     // When we choose to visit an unexplored state we stop the selection phase and will expand the node with the new child
     // During expansion we will update the table by calling store on it so no need to update it here in that case
-    if(bestChild)
-        table->update(bestMoveIdx);
+    if(bestChild){
+        table->update(bestMoveIdx, bestChild);
+        ++bestChild->vLoss;
+    }
     game->select(bestMoveIdx);
     return bestChild;
 }
 
-template<typename G, typename P>
+template<typename G, typename P, typename A>
 template<template<typename> typename T>
-RAVENode<G, P>* RAVENode<G, P>::expand(T<RAVENode<G, P>>* const table) {
+RAVENode<G, P, A>* RAVENode<G, P, A>::expand(T<RAVENode<G, P, A>>* const table, unsigned) {
     unsigned moveIdx = game->getLastMoveIdx();
-    return table->store(moveIdx);
+    RAVENode<G, P, A>* leaf = table->store(moveIdx);
+    ++leaf->vLoss;
+    return leaf;
 }
 
-template<typename G, typename P>
-void RAVENode<G, P>::updateMC(double val){
-    mcMean = (mcMean*mcCount+val)/(mcCount+1);
-    ++mcCount;
+template<typename G, typename P, typename A>
+void RAVENode<G, P, A>::updateMC(double val, unsigned weight){
+    mcMean = (double(mcMean)*mcCount+val*weight)/(mcCount+weight);
+    mcCount += weight;
 }
 
-template<typename G, typename P>
-void RAVENode<G, P>::updateRAVE(double outcome, const std::array<std::vector<unsigned>, 2>& takenMoves){
+template<typename G, typename P, typename A>
+void RAVENode<G, P, A>::updateRAVE(slice_type* amaf, double outcome, const std::array<std::vector<unsigned>, 2>& takenMoves){
     auto player = game->getNextPlayer();
     double val = outcome+player*(1.0-2.0*outcome);
     // update available moves with the ones that were taken
-    for(unsigned idx : takenMoves[player]){
-        rMean[idx] = (rMean[idx] * rCount[idx]+val)/(rCount[idx]+1);
-        ++rCount[idx];
-    }
+    for(unsigned idx : takenMoves[player])
+        A::update(amaf, initial.size(), idx, val);
 }
 
-template<typename G, typename P>
+template<typename G, typename P, typename A>
 template<template<typename> typename T>
-void RAVENode<G, P>::backprop(double outcome, T<RAVENode<G, P>>* const table, unsigned leafDepth){
+void RAVENode<G, P, A>::backprop(double outcome, T<RAVENode<G, P, A>>* const table, unsigned leafDepth, unsigned weight){
     auto it = game->getTakenMoves().rbegin();
-    std::array<std::vector<unsigned>, 2> takenMoves;
-    for(unsigned player = 0; player < 2; ++player){
-        takenMoves[player] = std::vector<unsigned>{};
-        takenMoves[player].reserve(game->getMaxDepth());
-    }
+    for(auto& moves : takenMoves)
+        moves.clear();
     // go up to leaf and gather played moves
     while(game->getCurrentDepth() != leafDepth){
         auto move = *it;
@@ -186,17 +284,21 @@ void RAVENode<G, P>::backprop(double outcome, T<RAVENode<G, P>>* const table, un
         // update because of depth
         game->undo();
     }
+    // AMAF values are updated by a single sample: the moves of the playout continued on this game
     // backprop
-    RAVENode<G, P>* current = this;
-    RAVENode<G, P>* currParent = table->backward();
+    RAVENode<G, P, A>* current = this;
+    RAVENode<G, P, A>* currParent = table->backward();
     while(currParent){
         // action value is updated with the next player
-        current->updateRAVE(outcome, takenMoves);
+        current->updateRAVE(current->getAMAF(table), outcome, takenMoves);
         // update because of available pieces
         game->undo();
         
         // state value is updated with parent's player
-        current->updateMC(outcome+game->getNextPlayer()*(1.0-2.0*outcome));
+        current->updateMC(outcome+game->getNextPlayer()*(1.0-2.0*outcome), weight);
+        // node might have been recycled and reset by an other thread in the meantime
+        if(current->vLoss)
+            --current->vLoss;
         auto move = *it;
         takenMoves[move.getPlayer()].push_back(game->toMoveIdx(move.getPiece(), move.getPos()));
         --it;
@@ -204,18 +306,35 @@ void RAVENode<G, P>::backprop(double outcome, T<RAVENode<G, P>>* const table, un
         currParent = table->backward();
     }
     // root
-    ++(current->mcCount);
-    current->updateRAVE(outcome, takenMoves);
+    current->mcCount += weight;
+    current->updateRAVE(current->getAMAF(table), outcome, takenMoves);
 }
 
-template<typename G, typename P>
-double RAVENode<G, P>::getStateScore() const {
+template<typename G, typename P, typename A>
+double RAVENode<G, P, A>::getStateScore() const {
     return mcMean;
 }
 
-template<typename G, typename P>
-double RAVENode<G, P>::getVisitCount() const {
+template<typename G, typename P, typename A>
+double RAVENode<G, P, A>::getVisitCount() const {
     return mcCount;
 }
 
+template<typename G, typename P, typename A>
+size_t RAVENode<G, P, A>::getNodeBytes(){
+    return sizeof(RAVENode<G, P, A>) + sliceSize() * sizeof(slice_type);
+}
+
+// RAVENode storing only the AMAF statistics of the moves that were played after the node
+template<typename G, typename P>
+using SparseRAVENode = RAVENode<G, P, SparseAMAF<>>;
+
+// RAVENode with float means and 32 bit counts
+template<typename G, typename P>
+using CompactRAVENode = RAVENode<G, P, DenseAMAF<CompactStats>>;
+
+// RAVENode caching the indices of its children
+template<typename G, typename P>
+using EdgeRAVENode = RAVENode<G, P, DenseAMAF<EdgeStats<>>>;
+
 #endif // RAVENODE_H
@@ -0,0 +1,170 @@
+#ifndef SELECTIONKERNEL_H
+#define SELECTIONKERNEL_H
+
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__) && !defined(MCTS_SCALAR_SELECTION)
+#include <immintrin.h>
+#define MCTS_SIMD_SELECTION
+#endif
+
+/**********************************************************************************
+ * Selection kernel of the nodes                                                  *
+ * - The children are scored in two passes: first the node gathers the moves and  *
+ * the statistics of its children into contiguous arrays (ChildBatch), then the   *
+ * kernel computes the scores and returns the index of the best child             *
+ * - With AVX2 (-mavx2 or -march with AVX2) 4 children are scored at once,        *
+ * otherwise one at a time. MCTS_SCALAR_SELECTION selects the scalar kernel even  *
+ * when AVX2 is available                                                         *
+ * - Both kernels compute the scores with the same operations and return the      *
+ * first child with the maximum score, like the loops they replace. When the      *
+ * compiler contracts them into FMA (-march=native without -ffp-contract=off)     *
+ * near ties may be broken differently                                            *
+ **********************************************************************************/
+
+// children of the node being selected, sized for the maximum number of valid moves
+template<typename N>
+struct ChildBatch
+{
+    void resize(unsigned size){
+        moveIdxs.resize(size);
+        nodes.resize(size);
+        means.resize(size);
+        terms.resize(size);
+    }
+
+    std::vector<unsigned> moveIdxs;
+    // nullptr for the children that are not in the table
+    std::vector<N*> nodes;
+    std::vector<double> means;
+    // second term of the scores: visit counts for UCT, AMAF means for RAVE
+    std::vector<double> terms;
+};
+
+class SelectionKernel
+{
+    ~SelectionKernel()=delete;
+    SelectionKernel()=delete;
+public:
+    // index of the first maximum of means[i] + sqrt(logc / counts[i])
+    static unsigned ucb(const double* means, const double* counts, unsigned size, double logc);
+    // index of the first maximum of (1 - beta) * means[i] + beta * amafMeans[i]
+    static unsigned blend(const double* means, const double* amafMeans, unsigned size, double beta);
+
+private:
+#ifdef MCTS_SIMD_SELECTION
+    // first maximum of the lanes of the running maximum
+    static inline unsigned reduce(__m256d maxScores, __m256d maxIdxs, double& maxScore);
+#endif
+};
+
+#ifdef MCTS_SIMD_SELECTION
+
+inline unsigned SelectionKernel::reduce(__m256d maxScores, __m256d maxIdxs, double& maxScore)
+{
+    alignas(32) double scores[4];
+    alignas(32) double idxs[4];
+    _mm256_store_pd(scores, maxScores);
+    _mm256_store_pd(idxs, maxIdxs);
+    unsigned best = 0;
+    // lanes hold the first maximum of their own indices, ties between the lanes go to the smaller index
+    for(unsigned lane = 1; lane < 4; ++lane){
+        if(scores[lane] > scores[best] || (scores[lane] == scores[best] && idxs[lane] < idxs[best]))
+            best = lane;
+    }
+    maxScore = scores[best];
+    return static_cast<unsigned>(idxs[best]);
+}
+
+inline unsigned SelectionKernel::ucb(const double* means, const double* counts, unsigned size, double logc)
+{
+    // indices are kept as doubles so they are blended with the same masks as the scores
+    __m256d maxScores = _mm256_set1_pd(-1);
+    __m256d maxIdxs = _mm256_setzero_pd();
+    __m256d idxs = _mm256_setr_pd(0, 1, 2, 3);
+    const __m256d step = _mm256_set1_pd(4);
+    const __m256d logcs = _mm256_set1_pd(logc);
+    unsigned idx = 0;
+    for(; idx + 4 <= size; idx += 4){
+        __m256d scores = _mm256_add_pd(_mm256_loadu_pd(means + idx),
+                                       _mm256_sqrt_pd(_mm256_div_pd(logcs, _mm256_loadu_pd(counts + idx))));
+        __m256d greater = _mm256_cmp_pd(scores, maxScores, _CMP_GT_OQ);
+        maxScores = _mm256_blendv_pd(maxScores, scores, greater);
+        maxIdxs = _mm256_blendv_pd(maxIdxs, idxs, greater);
+        idxs = _mm256_add_pd(idxs, step);
+    }
+    double maxScore;
+    unsigned best = reduce(maxScores, maxIdxs, maxScore);
+    for(; idx < size; ++idx){
+        double score = means[idx] + sqrt(logc / counts[idx]);
+        if(score > maxScore){
+            maxScore = score;
+            best = idx;
+        }
+    }
+    return best;
+}
+
+inline unsigned SelectionKernel::blend(const double* means, const double* amafMeans, unsigned size, double beta)
+{
+    __m256d maxScores = _mm256_set1_pd(-1);
+    __m256d maxIdxs = _mm256_setzero_pd();
+    __m256d idxs = _mm256_setr_pd(0, 1, 2, 3);
+    const __m256d step = _mm256_set1_pd(4);
+    const __m256d betas = _mm256_set1_pd(beta);
+    const __m256d alphas = _mm256_set1_pd(1 - beta);
+    unsigned idx = 0;
+    for(; idx + 4 <= size; idx += 4){
+        __m256d scores = _mm256_add_pd(_mm256_mul_pd(alphas, _mm256_loadu_pd(means + idx)),
+                                       _mm256_mul_pd(betas, _mm256_loadu_pd(amafMeans + idx)));
+        __m256d greater = _mm256_cmp_pd(scores, maxScores, _CMP_GT_OQ);
+        maxScores = _mm256_blendv_pd(maxScores, scores, greater);
+        maxIdxs = _mm256_blendv_pd(maxIdxs, idxs, greater);
+        idxs = _mm256_add_pd(idxs, step);
+    }
+    double maxScore;
+    unsigned best = reduce(maxScores, maxIdxs, maxScore);
+    for(; idx < size; ++idx){
+        double score = (1 - beta) * means[idx] + beta * amafMeans[idx];
+        if(score > maxScore){
+            maxScore = score;
+            best = idx;
+        }
+    }
+    return best;
+}
+
+#else
+
+inline unsigned SelectionKernel::ucb(const double* means, const double* counts, unsigned size, double logc)
+{
+    unsigned best = 0;
+    double maxScore = -1;
+    for(unsigned idx = 0; idx < size; ++idx){
+        double score = means[idx] + sqrt(logc / counts[idx]);
+        if(score > maxScore){
+            maxScore = score;
+            best = idx;
+        }
+    }
+    return best;
+}
+
+inline unsigned SelectionKernel::blend(const double* means, const double* amafMeans, unsigned size, double beta)
+{
+    unsigned best = 0;
+    double maxScore = -1;
+    for(unsigned idx = 0; idx < size; ++idx){
+        double score = (1 - beta) * means[idx] + beta * amafMeans[idx];
+        if(score > maxScore){
+            maxScore = score;
+            best = idx;
+        }
+    }
+    return best;
+}
+
+#endif
+
+#endif // SELECTIONKERNEL_H
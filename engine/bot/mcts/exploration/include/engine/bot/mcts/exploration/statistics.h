@@ -0,0 +1,40 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cstdint>
+
+/**********************************************************************************
+ * Number types of the node statistics                                            *
+ * - Means are stored in mean_type and visit counts in count_type, the updates    *
+ * are computed in double                                                         *
+ * - Counts are only increased by whole playouts (weights), so an unsigned count  *
+ * is exact. A float mean has about 7 significant digits which is below the       *
+ * noise of the Monte Carlo estimates                                             *
+ * - With edges the statistics of the children are stored together with the 32    *
+ * bit index of the child node (see the edges of the tables in zhashtablebase.h)  *
+ **********************************************************************************/
+
+// default, the statistics of a node take twice the memory of the compact ones
+struct DoubleStats
+{
+    typedef double mean_type;
+    typedef double count_type;
+    static constexpr bool edges = false;
+};
+
+// roughly twice as many nodes fit into the same memory
+struct CompactStats
+{
+    typedef float mean_type;
+    typedef uint32_t count_type;
+    static constexpr bool edges = false;
+};
+
+// children are served from their cached node indices instead of probing the table during selection
+template<typename S=DoubleStats>
+struct EdgeStats: S
+{
+    static constexpr bool edges = true;
+};
+
+#endif // STATISTICS_H
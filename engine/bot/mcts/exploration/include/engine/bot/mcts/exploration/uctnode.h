@@ -1,7 +1,12 @@
 #ifndef UCTNODE_H
 #define UCTNODE_H
 
-#include <vector>
+#include "statistics.h"
+#include "selectionkernel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
 
 /**********************************************************************************
  * UCTNode implementation (second variation) from                                 *
@@ -23,9 +28,16 @@
  * However, policy and game types should be made as class templates because these *
  * objects are used in the constructor and reset function, which is called from   *
  * the hashtable classes. Hashtable should not know about game and policy types   *
+ *                                                                                *
+ * The number types of the statistics are given by S (see statistics.h). With     *
+ * edges the statistics of the children are stored with the cached indices of the *
+ * child nodes, so the tables supporting them are not probed for the children     *
+ * that are already in the table                                                  *
+ *                                                                                *
+ * Children are scored by the selection kernel (see selectionkernel.h)            *
  **********************************************************************************/
 
-template<typename G, typename P>
+template<typename G, typename P, typename S=DoubleStats>
 class UCTNode
 {
 public:
@@ -40,143 +52,231 @@ public:
     static void setup(G* game, P* policy);
     void reset();
 
+    // ---- child statistics in the arena of the table (see NodeArena) ----
+    struct Child{
+        typename S::count_type count;
+    };
+    struct EdgeChild{
+        typename S::count_type count;
+        // index of the child node in the table
+        uint32_t edge;
+    };
+    typedef std::conditional_t<S::edges, EdgeChild, Child> slice_type;
+    static unsigned sliceSize();
+    void bind(unsigned slice);
+    unsigned getSlice() const;
+
+    // weight is the number of playouts aggregated in a single search cycle (leaf parallelisation)
     template<template<typename> typename T>
-    UCTNode<G, P>* select(T<UCTNode<G, P>>* const table);
+    UCTNode<G, P, S>* select(T<UCTNode<G, P, S>>* const table, unsigned weight=1);
 
     template<template<typename> typename T>
-    UCTNode<G, P>* expand(T<UCTNode<G, P>>* const table);
+    UCTNode<G, P, S>* expand(T<UCTNode<G, P, S>>* const table, unsigned weight=1);
 
+    // outcome is the mean outcome of the aggregated playouts
     template<template<typename> typename T>
-    void backprop(double outcome, T<UCTNode<G, P>>* const table, unsigned leafDepth);
+    void backprop(double outcome, T<UCTNode<G, P, S>>* const table, unsigned leafDepth, unsigned weight=1);
 
     // getters
     double getStateScore() const;
     double getVisitCount() const;
+    // memory of a node including its child statistics
+    static size_t getNodeBytes();
 
     // c value for balancing exploration and exploitation
     static constexpr double c = 2.0;
 protected:
 
-    inline double actionScore(UCTNode<G,P>* child, unsigned int childIdx, double logc) const;
+    // mean of a child in its score
+    static inline double childMean(const UCTNode<G, P, S>* child);
 
-    double mean;
-    double vCount;
+    // statistics of the children, they are initialized at the first access after a reset
+    template<template<typename> typename T>
+    inline slice_type* getChildren(T<UCTNode<G, P, S>>* const table);
+
+    typename S::mean_type mean;
+    typename S::count_type vCount;
 
-    inline static P* policy;
-    inline static G* game;
+    // number of search threads currently passing through the node (virtual loss)
+    unsigned vLoss;
+
+    // set separately for each search thread as they work on their own game and policy instances
+    // engines set them at each entry point so several engines can be used from the same thread
+    inline static thread_local P* policy;
+    inline static thread_local G* game;
+    // children of the node being selected
+    inline static thread_local ChildBatch<UCTNode<G, P, S>> batch;
 
     // We only store statistics for the available moves (children) to spare memory. As a result, we can not use
     // update items by direct move indexing (somewhat slower)
-    std::vector<double> vCounts;
+    // The slice of the arena of the table has room for the maximum number of valid moves, so there is no heap
+    // allocation when the number of valid moves increases in a new position
+    unsigned slice;
+    // the slice is not initialized since the last reset
+    bool fresh;
 };
 
-template<typename G, typename P>
-void UCTNode<G, P>::setup(G* game, P* policy)
+template<typename G, typename P, typename S>
+void UCTNode<G, P, S>::setup(G* game, P* policy)
 {
-    UCTNode<G, P>::game = game;
-    UCTNode<G, P>::policy = policy;
+    UCTNode<G, P, S>::game = game;
+    UCTNode<G, P, S>::policy = policy;
+    batch.resize(game->getMaxValidMoveNum());
 }
 
-template<typename G, typename P>
-void UCTNode<G, P>::reset(){
+template<typename G, typename P, typename S>
+void UCTNode<G, P, S>::reset(){
     mean = 0.5;
+    vLoss = 0;
     vCount = game->getValidMoves().size();
-    // here there is a potential for heap allocation when the number of valid moves can increase in a new position like in chess
-    // in other games like gomoku and omega this is not the case
-    // alternatively we could preallocate size to the maximum number of valid moves to avoid heap allocation but
-    // that would be at the expense of increasing memory footprint
-    vCounts.resize(vCount);
-    fill(vCounts.begin(), vCounts.end(), 1);
+    fresh = true;
 }
 
-template<typename G, typename P>
-UCTNode<G, P>::UCTNode()
+template<typename G, typename P, typename S>
+unsigned UCTNode<G, P, S>::sliceSize(){
+    return game->getMaxValidMoveNum();
+}
+
+template<typename G, typename P, typename S>
+void UCTNode<G, P, S>::bind(unsigned slice){
+    this->slice = slice;
+    fresh = true;
+}
+
+template<typename G, typename P, typename S>
+unsigned UCTNode<G, P, S>::getSlice() const{
+    return slice;
+}
+
+template<typename G, typename P, typename S>
+template<template<typename> typename T>
+typename UCTNode<G, P, S>::slice_type* UCTNode<G, P, S>::getChildren(T<UCTNode<G, P, S>>* const table){
+    slice_type* children = table->getArena().get(slice);
+    if(fresh){
+        std::fill(children, children + game->getMaxValidMoveNum(), slice_type{1});
+        fresh = false;
+    }
+    return children;
+}
+
+template<typename G, typename P, typename S>
+UCTNode<G, P, S>::UCTNode():
+    slice(0)
 {
     reset();
 }
 
-template<typename G, typename P>
-double UCTNode<G, P>::actionScore(UCTNode<G, P>* child, unsigned int childIdx, double logc) const {
-    return (child ? child->mean : 0.5) + sqrt(logc / vCounts[childIdx]);
+template<typename G, typename P, typename S>
+double UCTNode<G, P, S>::childMean(const UCTNode<G, P, S>* child) {
+    if(!child)
+        return 0.5;
+    // children selected by other threads are treated as if they had lost the pending playouts
+    return child->vLoss ? double(child->mean) * child->vCount / (child->vCount + child->vLoss) : child->mean;
 }
 
-template<typename G, typename P>
+template<typename G, typename P, typename S>
 template<template<typename> typename T>
-UCTNode<G, P>* UCTNode<G, P>::select(T<UCTNode<G, P>>* const table){
-    UCTNode<G, P>* bestChild = nullptr;
-    unsigned bestIdx;
-    unsigned bestMoveIdx;
-    double maxScore = -1;
-    double score;
-    unsigned idx=0;
+UCTNode<G, P, S>* UCTNode<G, P, S>::select(T<UCTNode<G, P, S>>* const table, unsigned weight){
+    constexpr bool edges = S::edges && T<UCTNode<G, P, S>>::edges;
     double logc = c * log(vCount + 1);
+    slice_type* children = getChildren(table);
+    // probes of the children are independent, their cache misses overlap when the entries are loaded up front
+    // thread_local statics are accessed through a wrapper call, the batch is looked up once
+    ChildBatch<UCTNode<G, P, S>>& batch = UCTNode<G, P, S>::batch;
+    unsigned size = 0;
     for(const auto& move : game->getValidMoves()){
         unsigned moveIdx = game->toMoveIdx(move.getPiece(), move.getPos());
-        UCTNode<G, P>* child = table->select(moveIdx);
-        score = actionScore(child, idx, logc);
-        if(score > maxScore){
-            maxScore = score;
-            bestChild = child;
-            bestMoveIdx = moveIdx;
-            bestIdx = idx;
-        }
-        ++idx;
+        if constexpr(T<UCTNode<G, P, S>>::prefetching)
+            table->prefetch(moveIdx);
+        batch.moveIdxs[size++] = moveIdx;
     }
+    for(unsigned idx = 0; idx < size; ++idx){
+        UCTNode<G, P, S>* child;
+        if constexpr(edges)
+            child = table->select(batch.moveIdxs[idx], children[idx].edge);
+        else
+            child = table->select(batch.moveIdxs[idx]);
+        batch.nodes[idx] = child;
+        batch.means[idx] = childMean(child);
+        batch.terms[idx] = children[idx].count;
+    }
+    unsigned bestIdx = SelectionKernel::ucb(batch.means.data(), batch.terms.data(), size, logc);
+    UCTNode<G, P, S>* bestChild = batch.nodes[bestIdx];
+    unsigned bestMoveIdx = batch.moveIdxs[bestIdx];
 
     // When we choose to visit an unexplored state we stop the selection phase and will expand the node with the new child
     // During expansion we will update the table by calling store on it so no need to update it here in that case
-    if(bestChild)
-        table->update(bestMoveIdx);
+    if(bestChild){
+        table->update(bestMoveIdx, bestChild);
+        ++bestChild->vLoss;
+    }
     game->select(bestMoveIdx);
     // update visit counts
-    ++vCount;
-    ++vCounts[bestIdx];
+    vCount += weight;
+    children[bestIdx].count += weight;
     return bestChild;
 }
 
-template<typename G, typename P>
+template<typename G, typename P, typename S>
 template<template<typename> typename T>
-UCTNode<G, P>* UCTNode<G, P>::expand(T<UCTNode<G, P>>* const table) {
+UCTNode<G, P, S>* UCTNode<G, P, S>::expand(T<UCTNode<G, P, S>>* const table, unsigned weight) {
     unsigned moveIdx = game->getLastMoveIdx();
-    UCTNode<G, P>* leaf = table->store(moveIdx);
+    UCTNode<G, P, S>* leaf = table->store(moveIdx);
+    ++leaf->vLoss;
     // simulate an action from leaf
     if(!game->end()){
         auto [_, childIdx] = policy->select();
         // update child statistics for leaf
-        ++leaf->vCount;
-        ++leaf->vCounts[childIdx];
+        leaf->vCount += weight;
+        leaf->getChildren(table)[childIdx].count += weight;
     }
     return leaf;
 }
 
-template<typename G, typename P>
+template<typename G, typename P, typename S>
 template<template<typename> typename T>
-void UCTNode<G, P>::backprop(double outcome, T<UCTNode<G, P>>* const table, unsigned leafDepth){
+void UCTNode<G, P, S>::backprop(double outcome, T<UCTNode<G, P, S>>* const table, unsigned leafDepth, unsigned weight){
     // go up to leaf
     while(game->getCurrentDepth() != leafDepth)
         game->undo();
     // backprop
-    UCTNode<G, P>* current = this;
-    UCTNode<G, P>* currParent = table->backward();
+    UCTNode<G, P, S>* current = this;
+    UCTNode<G, P, S>* currParent = table->backward();
     while(currParent){
         game->undo();
         // win: 1, draw: 0.5, lose: 0
         // Outcome is from the WHITE player's perspective, val is from the current player's perspective
         double val = outcome+game->getNextPlayer()*(1.0-2.0*outcome);
-        current->mean = (current->mean*(current->vCount-1)+val)/(current->vCount);
+        current->mean = (double(current->mean)*(current->vCount-weight)+val*weight)/(current->vCount);
+        // node might have been recycled and reset by an other thread in the meantime
+        if(current->vLoss)
+            --current->vLoss;
         current = currParent;
         currParent = table->backward();
     }
 }
 
-template<typename G, typename P>
-double UCTNode<G, P>::getStateScore() const {
+template<typename G, typename P, typename S>
+double UCTNode<G, P, S>::getStateScore() const {
     return mean;
 }
 
-template<typename G, typename P>
-double UCTNode<G, P>::getVisitCount() const {
+template<typename G, typename P, typename S>
+double UCTNode<G, P, S>::getVisitCount() const {
     return vCount;
 }
 
+template<typename G, typename P, typename S>
+size_t UCTNode<G, P, S>::getNodeBytes(){
+    return sizeof(UCTNode<G, P, S>) + sliceSize() * sizeof(slice_type);
+}
+
+// UCTNode with float means and 32 bit counts
+template<typename G, typename P>
+using CompactUCTNode = UCTNode<G, P, CompactStats>;
+
+// UCTNode caching the indices of its children
+template<typename G, typename P>
+using EdgeUCTNode = UCTNode<G, P, EdgeStats<>>;
+
 #endif // UCTNODE_H
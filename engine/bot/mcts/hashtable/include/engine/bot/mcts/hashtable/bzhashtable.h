@@ -0,0 +1,376 @@
+#ifndef BZHASHTABLE_H
+#define BZHASHTABLE_H
+
+#include "zhashtablebase.h"
+#include "nodearena.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/**********************************************************************************
+ * Bucket Zobrist HashTable                                                       *
+ * - Same replacement scheme as ZHashTable, but the entries of a hash code are    *
+ * stored inline in a bucket of a single cache line: 4 ways of key tag, depth,    *
+ * visit count and node index. A lookup loads one cache line and only the node    *
+ * that matches the tag is touched                                                *
+ * - When the bucket is full we discard the node that is not reachable anymore,   *
+ * otherwise the deepest one, if they are at the same depth we keep the ones      *
+ * that have been visited more. Visit counts are the number of times the table    *
+ * descended through the node                                                     *
+ * - Nodes are allocated by chunks as the buckets fill up, up to budget nodes.    *
+ * Nodes cut off above the root are returned to a free list when the root is      *
+ * updated. When the budget is used up nodes are only replaced, like in           *
+ * ZHashTable. Replaced nodes keep their slices of per move arrays (see           *
+ * NodeArena)                                                                     *
+ * - Buckets of the children can be prefetched before they are scored             *
+ * - Parents can cache the node indices of their children (edges). Nodes out of   *
+ * the buckets have no key, see ZHashTable                                        *
+ **********************************************************************************/
+
+template<typename T>
+class BZHashTable: public ZHashTableBase<BZHashTable<T>>
+{
+public:
+    ZHASHTABLEBASE_SETUP(BZHashTable<T>)
+
+    static constexpr bool prefetching = true;
+    static constexpr bool edges = true;
+    static constexpr unsigned WAYS = 4;
+
+    BZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=18, unsigned budget=50000);
+    ~BZHashTable();
+
+    BZHashTable(const BZHashTable&)=delete;
+    BZHashTable& operator=(const BZHashTable&)=delete;
+    BZHashTable(BZHashTable&&)=delete;
+    BZHashTable& operator=(BZHashTable&&)=delete;
+
+    // loads node, returns nullptr when it is not in the table
+    T* select(unsigned moveIdx) const;
+    // loads node from the cached index of the caller (edge) when it still holds the node, probes the table and
+    // updates the edge otherwise
+    T* select(unsigned moveIdx, uint32_t& edge) const;
+
+    template<class... Args>
+    T* store(unsigned moveIdx, Args&&... args);
+
+    template<class... Args>
+    T* updateRoot(unsigned moveIdx, Args&&... args);
+
+    // overwrite base update function to count the visits of the entries
+    void update(unsigned moveIdx, T* node);
+    // loads the bucket of a child into the cache
+    void prefetch(unsigned moveIdx) const;
+
+    // table sharing the nodes with this one but following its own search path. Used by additional
+    // search threads, the caller is responsible for synchronizing the access to the shared nodes
+    BZHashTable* createWorker();
+
+    NodeArena<T>& getArena();
+
+    // ---- table sizes (see tablesize.h) ----
+    // maximum ratio of the budget and the node capacity
+    static constexpr double MAXLOAD = 1.0;
+    // number of nodes the entries can hold
+    static size_t nodeCapacity(unsigned hashCodeSize);
+    // memory of a table with budget nodes
+    static size_t bytes(unsigned hashCodeSize, unsigned budget);
+
+protected:
+    BZHashTable(BZHashTable* owner);
+
+    static constexpr uint32_t EMPTY = ~0u;
+    // nodes per chunk of the pool
+    static constexpr unsigned CHUNKBITS = 12;
+    static constexpr unsigned CHUNKMASK = (1u << CHUNKBITS) - 1;
+
+    struct Entry{
+        // upper half of the key, the full key is compared at the node
+        uint32_t tag = 0;
+        uint32_t depth = 0;
+        uint32_t visits = 0;
+        uint32_t node = EMPTY;
+    };
+
+    struct alignas(64) Bucket{
+        Entry entries[WAYS];
+    };
+    static_assert(sizeof(Bucket) == 64, "BZHashTable: bucket should fill a single cache line");
+
+    // buckets and nodes, shared with the worker tables
+    struct Storage{
+        std::unique_ptr<Bucket[]> buckets;
+        // chunk pointers are not reallocated so the nodes can be read while others are added
+        std::unique_ptr<std::unique_ptr<HashNode[]>[]> chunks;
+        unsigned chunkNum = 0;
+        unsigned budget = 0;
+        // number of nodes handed out
+        unsigned size = 0;
+        std::vector<uint32_t> freeNodes;
+        NodeArena<T> arena;
+    };
+
+    inline HashNode& getNode(uint32_t idx) const;
+    // entry of the key in the bucket of code, nullptr when it is not in the table
+    inline Entry* find(ull code, ull key) const;
+    // hands out a new node from the pool, EMPTY when it is used up
+    uint32_t allocate();
+    // returns the nodes above depth to the pool
+    void release(unsigned depth);
+    // node out of the buckets, it is not found through the edges anymore
+    inline void unlink(uint32_t idx);
+
+    void setupExploration();
+
+    std::shared_ptr<Storage> storage;
+    Bucket* const buckets;
+    T* rp;
+    // node of the table for replacing the next one in a full bucket, replaced nodes stay alive until
+    // the next replacement so the backpropagation can pass through them
+    uint32_t helperNode;
+};
+
+template<typename T>
+BZHashTable<T>::BZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned budget):
+    ZHashTableBase<BZHashTable<T>>(moveNum, maxDepth, hashCodeSize),
+    storage(std::make_shared<Storage>()),
+    buckets(new Bucket[static_cast<size_t>(pow(2, hashCodeSize))]),
+    rp(nullptr)
+{
+    storage->buckets.reset(buckets);
+    // a node for the root and for the helper of the table
+    if(budget < 2)
+        throw std::invalid_argument( "BZHashTable: budget should be greater than 1" );
+    storage->budget = budget;
+    storage->chunks.reset(new std::unique_ptr<HashNode[]>[(budget + CHUNKMASK) >> CHUNKBITS]);
+    storage->freeNodes.reserve(budget);
+    storage->arena.reserve(budget);
+    helperNode = allocate();
+}
+
+template<typename T>
+BZHashTable<T>::BZHashTable(BZHashTable* owner):
+    ZHashTableBase<BZHashTable<T>>(owner),
+    storage(owner->storage),
+    buckets(owner->buckets),
+    rp(nullptr)
+{
+    helperNode = allocate();
+    if(helperNode == EMPTY)
+        throw std::invalid_argument( "BZHashTable: budget is used up by the worker tables" );
+}
+
+template<typename T>
+BZHashTable<T>::~BZHashTable()
+{
+    if(Base::owner){
+        unlink(helperNode);
+        storage->freeNodes.push_back(helperNode);
+    }
+}
+
+template<typename T>
+BZHashTable<T>* BZHashTable<T>::createWorker()
+{
+    return new BZHashTable(this);
+}
+
+template<typename T>
+NodeArena<T>& BZHashTable<T>::getArena()
+{
+    return storage->arena;
+}
+
+template<typename T>
+inline typename BZHashTable<T>::HashNode& BZHashTable<T>::getNode(uint32_t idx) const
+{
+    return storage->chunks[idx >> CHUNKBITS][idx & CHUNKMASK];
+}
+
+template<typename T>
+size_t BZHashTable<T>::nodeCapacity(unsigned hashCodeSize)
+{
+    return WAYS * (size_t(1) << hashCodeSize);
+}
+
+template<typename T>
+size_t BZHashTable<T>::bytes(unsigned hashCodeSize, unsigned budget)
+{
+    return (size_t(1) << hashCodeSize) * sizeof(Bucket) + budget * (sizeof(HashNode) + sizeof(uint32_t)) +
+           NodeArena<T>::bytes(budget);
+}
+
+template<typename T>
+uint32_t BZHashTable<T>::allocate()
+{
+    if(!storage->freeNodes.empty()){
+        uint32_t idx = storage->freeNodes.back();
+        storage->freeNodes.pop_back();
+        return idx;
+    }
+    if(storage->size == storage->budget)
+        return EMPTY;
+    if(storage->size == (storage->chunkNum << CHUNKBITS)){
+        storage->chunks[storage->chunkNum].reset(new HashNode[std::min(CHUNKMASK + 1, storage->budget - storage->size)]);
+        ++storage->chunkNum;
+    }
+    uint32_t idx = storage->size++;
+    storage->arena.bind(getNode(idx).impl);
+    return idx;
+}
+
+template<typename T>
+void BZHashTable<T>::release(unsigned depth)
+{
+    // nodes above the root can not be reached from the root anymore
+    for(size_t code = 0; code <= Base::hashCodeMask; ++code){
+        for(Entry& entry : buckets[code].entries){
+            if(entry.node != EMPTY && entry.depth < depth){
+                unlink(entry.node);
+                storage->freeNodes.push_back(entry.node);
+                entry.node = EMPTY;
+            }
+        }
+    }
+}
+
+template<typename T>
+inline typename BZHashTable<T>::Entry* BZHashTable<T>::find(ull code, ull key) const
+{
+    // see ZHashTable::select for the case of 2 states mapped to the same entry with the same hashKey
+    uint32_t tag = key >> 32;
+    for(Entry& entry : buckets[code].entries){
+        if(entry.node != EMPTY && entry.tag == tag && getNode(entry.node).key == key)
+            return std::addressof(entry);
+    }
+    return nullptr;
+}
+
+template<typename T>
+T* BZHashTable<T>::select(unsigned moveIdx) const
+{
+    Entry* entry = find(Base::currCode ^ Base::hashCodes[moveIdx], Base::currKey ^ Base::hashKeys[moveIdx]);
+    if(entry)
+        return std::addressof(getNode(entry->node).impl);
+    return rp; // nullptr during selection, removed node during backpropagation
+}
+
+template<typename T>
+T* BZHashTable<T>::select(unsigned moveIdx, uint32_t& edge) const
+{
+    ull key = Base::currKey ^ Base::hashKeys[moveIdx];
+    if(getNode(edge).key == key)
+        return std::addressof(getNode(edge).impl);
+    Entry* entry = find(Base::currCode ^ Base::hashCodes[moveIdx], key);
+    if(!entry)
+        return nullptr;
+    edge = entry->node;
+    return std::addressof(getNode(edge).impl);
+}
+
+template<typename T>
+inline void BZHashTable<T>::unlink(uint32_t idx)
+{
+    // 0 is taken as no state, see ZHashTable
+    getNode(idx).key = 0;
+}
+
+template<typename T>
+void BZHashTable<T>::prefetch(unsigned moveIdx) const
+{
+    __builtin_prefetch(buckets + (Base::currCode ^ Base::hashCodes[moveIdx]));
+}
+
+template<typename T>
+void BZHashTable<T>::update(unsigned moveIdx, T* node)
+{
+    // Zobrist hashing
+    Base::update(moveIdx, node);
+    // the entry is matched by its node, the other nodes of the bucket are not loaded
+    for(Entry& entry : buckets[Base::currCode].entries){
+        if(entry.node != EMPTY && std::addressof(getNode(entry.node).impl) == node){
+            ++entry.visits;
+            return;
+        }
+    }
+}
+
+template<typename T>
+template<class... Args>
+T* BZHashTable<T>::store(unsigned moveIdx, Args&&... args)
+{
+    // zobrist hashing
+    Base::update(moveIdx);
+    Entry* entries = buckets[Base::currCode].entries;
+    Entry* target = std::find_if(entries, entries + WAYS, [](const Entry& entry){ return entry.node == EMPTY; });
+    uint32_t idx = target != entries + WAYS ? allocate() : EMPTY;
+    if(idx == EMPTY){
+        // replacement scheme
+        // reachable ? -> closer to root ? -> visit count ?
+        // the root is at rootDepth, only the nodes above it are unreachable
+        target = nullptr;
+        for(Entry& entry : buckets[Base::currCode].entries){
+            if(entry.node == EMPTY)
+                continue;
+            if(entry.depth < Base::rootDepth){
+                target = std::addressof(entry);
+                break;
+            }
+            if(!target || entry.depth > target->depth || (entry.depth == target->depth && entry.visits <= target->visits))
+                target = std::addressof(entry);
+        }
+    }
+    if(!target){
+        // pool is used up, the leaf is only kept for the current search cycle
+        HashNode& leaf = getNode(helperNode);
+        leaf.reset(Base::currKey, Base::currCode, std::forward<Args>(args)...);
+        rp = std::addressof(leaf.impl);
+        return Base::track(rp);
+    }
+    if(idx != EMPTY)
+        target->node = idx;
+    else{
+        // we overwrite replaced node after backpropagation
+        // because node might be removed from the selection path
+        std::swap(target->node, helperNode);
+        unlink(helperNode);
+    }
+    target->tag = Base::currKey >> 32;
+    target->depth = Base::depth;
+    target->visits = 0;
+    HashNode& node = getNode(target->node);
+    node.reset(Base::currKey, Base::currCode, std::forward<Args>(args)...);
+    // if deleted node is one of the parents we can still do backpropagation
+    rp = std::addressof(getNode(helperNode).impl);
+    return Base::track(std::addressof(node.impl));
+}
+
+template<typename T>
+template<class... Args>
+T* BZHashTable<T>::updateRoot(unsigned moveIdx, Args&&... args){
+    auto root = select(moveIdx);
+    if(!root){
+        ++Base::rootDepth;
+        // the new root should not be left out of the table when the pool is used up, the nodes of the
+        // previous search are discarded in that case
+        release(storage->freeNodes.empty() && storage->size == storage->budget ? ~0u : Base::rootDepth);
+        root = store(moveIdx, std::forward<Args>(args)...);
+    }
+    else{
+        Base::updateRoot(moveIdx, root);
+        release(Base::rootDepth);
+    }
+    rp = nullptr;
+    return root;
+}
+
+template<typename T>
+void BZHashTable<T>::setupExploration(){
+    rp = nullptr;
+    // the helper might hold a leaf that was not stored
+    unlink(helperNode);
+}
+
+#endif // BZHASHTABLE_H
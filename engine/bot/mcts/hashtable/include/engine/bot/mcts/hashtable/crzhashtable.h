@@ -0,0 +1,515 @@
+#ifndef CRZHASHTABLE_H
+#define CRZHASHTABLE_H
+
+#include "zhashtablebase.h"
+#include "nodearena.h"
+#include "engine/bot/mcts/affinity/affinity.h"
+
+#include <atomic>
+#include <climits>
+#include <exception>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+
+/**********************************************************************************
+ * Concurrent Recycling Zobrist HashTable                                         *
+ * - Same interface and node recycling semantics as RZHashTable, but the table    *
+ * can be used by several search threads through worker tables without locking   *
+ * - Entries store node indices and are claimed by CAS in store, select probes    *
+ * them with atomic loads                                                         *
+ * - The recycling order approximates the least recently visited node by a clock  *
+ * (second chance) algorithm: visited nodes get a reference bit that is cleared   *
+ * by the clock hand before the node can be recycled. This needs no global list   *
+ * so there is no lock on the recycling order                                     *
+ * - Removed entries become tombstones instead of shifting the following entries  *
+ * (which can not be done atomically). store reuses them and they are cleaned up  *
+ * when the root is updated                                                       *
+ * - The caller is still responsible for synchronizing the access to the node     *
+ * statistics. Nodes on the selection path of an other thread might be recycled   *
+ * just like with RZHashTable                                                     *
+ * - Per move arrays of the nodes (see NodeArena) are reserved with the nodes and *
+ * kept when they are recycled                                                    *
+ * - There is no heap allocation during the search phase                          *
+ *                                                                                *
+ * NUMA sharding:                                                                 *
+ * - Entries and nodes are split into shards selected by the upper bits of the    *
+ * hash code. A state is stored by a node of the shard of its entry and linear    *
+ * probing wraps around within the shard, so a lookup stays on a single shard     *
+ * - Each shard has its own memory mapping, node pool and clock hand. The pages   *
+ * are first touched by a thread pinned to the CPU given for the shard, so with   *
+ * one CPU per NUMA node (see Affinity::getNodeCpus) the shards are spread over   *
+ * the nodes. Hash codes are uniform so the accesses are spread evenly as well    *
+ **********************************************************************************/
+
+template<typename T>
+class CRZHashTable: public ZHashTableBase<CRZHashTable<T>>
+{
+public:
+    ZHASHTABLEBASE_SETUP(CRZHashTable<T>)
+
+    // shardCpus: CPU initializing the memory of each shard, the number of shards is the greatest power of 2
+    // not exceeding its size (a single shard initialized by the calling thread when it is empty)
+    CRZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=20, unsigned budget=50000,
+                 const std::vector<unsigned>& shardCpus={});
+    ~CRZHashTable()=default;
+
+    CRZHashTable(const CRZHashTable&)=delete;
+    CRZHashTable& operator=(const CRZHashTable&)=delete;
+    CRZHashTable(CRZHashTable&&)=delete;
+    CRZHashTable& operator=(CRZHashTable&&)=delete;
+
+    // loads node, returns nullptr when it is not in the table
+    T* select(unsigned moveIdx);
+    template<class... Args>
+    T* store(unsigned moveIdx, Args&&... args);
+    // root needs to be overriden by the best child from the previous search
+    // not thread safe, it should not be called during the search
+    template<class... Args>
+    T* updateRoot(unsigned moveIdx, Args&&... args);
+
+    template<class... Args>
+    T* createRoot(Args&&... args);
+
+    // overwrite base update function
+    void update(unsigned moveIdx, T* node);
+
+    // table sharing the nodes and entries with this one but following its own search path
+    CRZHashTable* createWorker();
+
+    NodeArena<T>& getArena();
+
+    // ---- table sizes (see tablesize.h) ----
+    // maximum ratio of the budget and the node capacity
+    static constexpr double MAXLOAD = 0.5;
+    // number of nodes the entries can hold
+    static size_t nodeCapacity(unsigned hashCodeSize);
+    // memory of a table with budget nodes
+    static size_t bytes(unsigned hashCodeSize, unsigned budget);
+
+protected:
+    CRZHashTable(CRZHashTable* owner);
+
+    // wrapper around underlying node type with atomic key and reference bit
+    struct CHashNode{
+        // nodes of a shard are copies of a node created on the thread of the table, the search threads
+        // might not be set up on the thread initializing the shard
+        CHashNode(const T& impl):
+        impl(impl),
+        key(0),
+        code(0),
+        visited(false),
+        busy(false){}
+
+        template<class... Args>
+        void reset(ull key, ull code, Args&&... args){
+            this->code = code;
+            impl.reset(std::forward<Args>(args)...);
+            this->key.store(key, std::memory_order_release);
+        }
+
+        T impl;
+        std::atomic<ull> key;
+        // only changed by the thread recycling the node
+        ull code;
+        // reference bit of the clock algorithm
+        std::atomic<bool> visited;
+        // set while the node is being recycled
+        std::atomic<bool> busy;
+    };
+
+    // entry flags
+    static constexpr unsigned EMPTY = UINT_MAX;
+    static constexpr unsigned TOMBSTONE = UINT_MAX - 1;
+
+    // entries and nodes of a shard, entries store node indices within the shard
+    // counters are on their own cache lines as every thread of the shard updates them
+    struct alignas(64) Shard{
+        CHashNode* nodes = nullptr;
+        std::atomic<unsigned>* table = nullptr;
+        // number of constructed nodes
+        unsigned built = 0;
+        // number of nodes handed out before the first recycling
+        alignas(64) std::atomic<unsigned> used{0};
+        // clock hand
+        alignas(64) std::atomic<unsigned> hand{0};
+    };
+
+    // nodes and entries, shared with the worker tables
+    struct Storage{
+        // the nodes and entries are split evenly into 2^shardBits shards
+        Storage(unsigned shardBits, unsigned hashCodeSize, unsigned budget);
+        ~Storage();
+
+        // allocates and constructs the entries and nodes of each shard on its CPU
+        void build(const std::vector<unsigned>& shardCpus, const T& prototype);
+
+        const unsigned shardBits;
+        const unsigned shardNum;
+        // number of entries in a shard
+        const unsigned shardSize;
+        // number of nodes in a shard
+        const unsigned shardBudget;
+        std::unique_ptr<Shard[]> shards;
+        std::atomic<unsigned> tombstones;
+        // never recycled
+        std::atomic<CHashNode*> root;
+        // slices are first touched by the search threads, not by the threads of the shards
+        NodeArena<T> arena;
+    };
+
+    // probes the entries of a shard from the code of a node, returns the node or nullptr
+    inline CHashNode* find(ull code, ull key);
+    // wrapper of a node of the table, the node is its first member
+    static inline CHashNode* wrapperOf(const T* node);
+    // path nodes might be recycled by other threads
+    bool holds(const T* node) const;
+    // node index to recycle within the shard
+    unsigned claim(Shard& shard);
+    // puts node index to the first free entry of the shard from code
+    void publish(Shard& shard, ull code, unsigned nodeIdx);
+    // clean up tombstones, not thread safe
+    void rebuild();
+
+    void setupExploration();
+
+    std::shared_ptr<Storage> storage;
+    Shard* const shards;
+    // the shard of a code is given by its bits from shardShift
+    const unsigned shardShift;
+    // entry index within the shard
+    const ull shardMask;
+    // node found by the last lookup or store
+    CHashNode* found;
+};
+
+template<typename T>
+CRZHashTable<T>::Storage::Storage(unsigned shardBits, unsigned hashCodeSize, unsigned budget):
+    shardBits(shardBits),
+    shardNum(1u << shardBits),
+    shardSize(1u << (hashCodeSize - shardBits)),
+    shardBudget(budget >> shardBits),
+    shards(new Shard[shardNum]),
+    tombstones(0),
+    root(nullptr)
+{
+}
+
+template<typename T>
+CRZHashTable<T>::Storage::~Storage()
+{
+    for(unsigned shardIdx = 0; shardIdx < shardNum; ++shardIdx){
+        Shard& shard = shards[shardIdx];
+        for(unsigned nodeIdx = 0; nodeIdx < shard.built; ++nodeIdx)
+            shard.nodes[nodeIdx].~CHashNode();
+        if(shard.nodes)
+            munmap(shard.nodes, shardBudget * sizeof(CHashNode));
+        if(shard.table)
+            munmap(shard.table, shardSize * sizeof(std::atomic<unsigned>));
+    }
+}
+
+template<typename T>
+void CRZHashTable<T>::Storage::build(const std::vector<unsigned>& shardCpus, const T& prototype)
+{
+    auto allocate = [](size_t size){
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED)
+            throw std::bad_alloc();
+        return memory;
+    };
+    std::vector<std::exception_ptr> errors(shardNum);
+    auto buildShard = [&](unsigned shardIdx){
+        try{
+            Shard& shard = shards[shardIdx];
+            // first touch places the pages on the NUMA node of the thread
+            if(!shardCpus.empty())
+                Affinity::pinCpu(shardCpus[shardIdx]);
+            // pages are not touched until the entries and nodes are constructed
+            shard.nodes = static_cast<CHashNode*>(allocate(shardBudget * sizeof(CHashNode)));
+            shard.table = static_cast<std::atomic<unsigned>*>(allocate(shardSize * sizeof(std::atomic<unsigned>)));
+            for(unsigned entryIdx = 0; entryIdx < shardSize; ++entryIdx)
+                new (shard.table + entryIdx) std::atomic<unsigned>(EMPTY);
+            for(; shard.built < shardBudget; ++shard.built)
+                new (shard.nodes + shard.built) CHashNode(prototype);
+        }
+        catch(...){
+            errors[shardIdx] = std::current_exception();
+        }
+    };
+    // the calling thread is not pinned
+    if(shardCpus.empty())
+        buildShard(0);
+    else{
+        std::vector<std::thread> threads;
+        for(unsigned shardIdx = 0; shardIdx < shardNum; ++shardIdx)
+            threads.emplace_back(buildShard, shardIdx);
+        for(auto& thread : threads)
+            thread.join();
+    }
+    for(auto& error : errors){
+        if(error)
+            std::rethrow_exception(error);
+    }
+    arena.reserve(shardNum * shardBudget);
+    for(unsigned shardIdx = 0; shardIdx < shardNum; ++shardIdx){
+        for(unsigned nodeIdx = 0; nodeIdx < shardBudget; ++nodeIdx)
+            arena.bind(shards[shardIdx].nodes[nodeIdx].impl);
+    }
+}
+
+namespace CRZHashTableDetail{
+    // number of shards, the greatest power of 2 not exceeding the number of shard CPUs
+    inline unsigned shardBits(const std::vector<unsigned>& shardCpus, unsigned hashCodeSize){
+        unsigned bits = 0;
+        while(bits < hashCodeSize && (2u << bits) <= shardCpus.size())
+            ++bits;
+        return bits;
+    }
+}
+
+template<typename T>
+CRZHashTable<T>::CRZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned budget,
+                              const std::vector<unsigned>& shardCpus):
+    ZHashTableBase<CRZHashTable<T>>(moveNum, maxDepth, hashCodeSize),
+    storage(std::make_shared<Storage>(CRZHashTableDetail::shardBits(shardCpus, hashCodeSize), hashCodeSize, budget)),
+    shards(storage->shards.get()),
+    shardShift(hashCodeSize - storage->shardBits),
+    shardMask(storage->shardSize - 1),
+    found(nullptr)
+{
+    unsigned tableSize = pow(2, hashCodeSize);
+    if(tableSize < 2 * budget)
+        throw std::invalid_argument( "CRZHashTable: load factor should not exceed 0.5" );
+    if(budget < maxDepth + 1)
+        throw std::invalid_argument( "CRZHashTable: budget should be greater than " + std::to_string(maxDepth) );
+    std::vector<unsigned> cpus(shardCpus.begin(), shardCpus.begin() + std::min<size_t>(shardCpus.size(), storage->shardNum));
+    storage->build(cpus, T());
+}
+
+template<typename T>
+CRZHashTable<T>::CRZHashTable(CRZHashTable* owner):
+    ZHashTableBase<CRZHashTable<T>>(owner),
+    storage(owner->storage),
+    shards(owner->shards),
+    shardShift(owner->shardShift),
+    shardMask(owner->shardMask),
+    found(nullptr)
+{
+}
+
+template<typename T>
+CRZHashTable<T>* CRZHashTable<T>::createWorker()
+{
+    return new CRZHashTable(this);
+}
+
+template<typename T>
+NodeArena<T>& CRZHashTable<T>::getArena()
+{
+    return storage->arena;
+}
+
+template<typename T>
+size_t CRZHashTable<T>::nodeCapacity(unsigned hashCodeSize)
+{
+    return (size_t(1) << hashCodeSize);
+}
+
+template<typename T>
+size_t CRZHashTable<T>::bytes(unsigned hashCodeSize, unsigned budget)
+{
+    return (size_t(1) << hashCodeSize) * sizeof(std::atomic<unsigned>) + budget * sizeof(CHashNode) +
+           NodeArena<T>::bytes(budget);
+}
+
+template<typename T>
+inline typename CRZHashTable<T>::CHashNode* CRZHashTable<T>::find(ull code, ull key)
+{
+    Shard& shard = shards[code >> shardShift];
+    code &= shardMask;
+    // linear probing
+    // tombstones are only removed when the root is updated so in a long search they might fill up
+    // all the empty entries, probing stops after a whole round to prevent an infinite loop
+    unsigned nodeIdx = shard.table[code].load(std::memory_order_acquire);
+    for(ull steps = 0; nodeIdx != EMPTY && steps <= shardMask; ++steps){
+        // node might be recycled concurrently, then its key differs or it is a state we look for anyway
+        if(nodeIdx != TOMBSTONE && shard.nodes[nodeIdx].key.load(std::memory_order_acquire) == key)
+            return shard.nodes + nodeIdx;
+        code = (code + 1) & shardMask;
+        nodeIdx = shard.table[code].load(std::memory_order_acquire);
+    }
+    return nullptr;
+}
+
+template<typename T>
+inline typename CRZHashTable<T>::CHashNode* CRZHashTable<T>::wrapperOf(const T* node)
+{
+    return reinterpret_cast<CHashNode*>(const_cast<T*>(node));
+}
+
+template<typename T>
+bool CRZHashTable<T>::holds(const T* node) const
+{
+    return wrapperOf(node)->key.load(std::memory_order_acquire) == Base::currKey;
+}
+
+template<typename T>
+T* CRZHashTable<T>::select(unsigned moveIdx)
+{
+    found = find(Base::currCode ^ Base::hashCodes[moveIdx], Base::currKey ^ Base::hashKeys[moveIdx]);
+    // see RZHashTable::select for the case of 2 states mapped to the same entry with the same hashKey
+    return found ? std::addressof(found->impl) : nullptr;
+}
+
+template<typename T>
+void CRZHashTable<T>::update(unsigned moveIdx, T* node)
+{
+    // Zobrist hashing
+    Base::update(moveIdx, node);
+    found = wrapperOf(node);
+    // give the node a second chance (instead of moving it to the back of the fifo)
+    found->visited.store(true, std::memory_order_relaxed);
+}
+
+template<typename T>
+unsigned CRZHashTable<T>::claim(Shard& shard)
+{
+    const unsigned shardBudget = storage->shardBudget;
+    // fresh nodes first
+    if(shard.used.load(std::memory_order_relaxed) < shardBudget){
+        unsigned nodeIdx = shard.used.fetch_add(1, std::memory_order_relaxed);
+        if(nodeIdx < shardBudget){
+            shard.nodes[nodeIdx].busy.store(true, std::memory_order_relaxed);
+            return nodeIdx;
+        }
+    }
+    // clock algorithm: recycle the first node that was not visited since the last pass of the hand
+    while(true){
+        unsigned nodeIdx = shard.hand.fetch_add(1, std::memory_order_relaxed) % shardBudget;
+        CHashNode& node = shard.nodes[nodeIdx];
+        if(&node == storage->root.load(std::memory_order_relaxed)
+           || node.visited.exchange(false, std::memory_order_relaxed))
+            continue;
+        bool busy = false;
+        if(!node.busy.compare_exchange_strong(busy, true, std::memory_order_acquire))
+            continue;
+        // remove node from the table, it can not be found by new lookups from now on
+        ull code = node.code & shardMask;
+        unsigned entry = shard.table[code].load(std::memory_order_acquire);
+        while(entry != EMPTY){
+            if(entry == nodeIdx){
+                if(shard.table[code].compare_exchange_strong(entry, TOMBSTONE, std::memory_order_acq_rel)){
+                    storage->tombstones.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+                // entry has changed in the meantime, check it again
+                continue;
+            }
+            code = (code + 1) & shardMask;
+            entry = shard.table[code].load(std::memory_order_acquire);
+        }
+        return nodeIdx;
+    }
+}
+
+template<typename T>
+void CRZHashTable<T>::publish(Shard& shard, ull code, unsigned nodeIdx)
+{
+    code &= shardMask;
+    while(true){
+        unsigned entry = shard.table[code].load(std::memory_order_acquire);
+        if(entry == EMPTY || entry == TOMBSTONE){
+            if(shard.table[code].compare_exchange_strong(entry, nodeIdx, std::memory_order_acq_rel)){
+                if(entry == TOMBSTONE)
+                    storage->tombstones.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            // claimed by an other thread in the meantime, check it again
+            continue;
+        }
+        code = (code + 1) & shardMask;
+    }
+}
+
+template<typename T>
+template<class... Args>
+T* CRZHashTable<T>::store(unsigned moveIdx, Args&&... args)
+{
+    T* node = select(moveIdx);
+    // Zobrist hashing
+    Base::update(moveIdx);
+
+    if(node){
+        found->visited.store(true, std::memory_order_relaxed);
+        return Base::track(node);
+    }
+
+    // two threads might store the same state at the same time, in that case one of the duplicates
+    // is never found again and it is recycled like any other unvisited node
+    Shard& shard = shards[Base::currCode >> shardShift];
+    unsigned nodeIdx = claim(shard);
+    found = shard.nodes + nodeIdx;
+    found->reset(Base::currKey, Base::currCode, std::forward<Args>(args)...);
+    found->visited.store(true, std::memory_order_relaxed);
+    publish(shard, Base::currCode, nodeIdx);
+    found->busy.store(false, std::memory_order_release);
+    return Base::track(std::addressof(found->impl));
+}
+
+template<typename T>
+template<class... Args>
+T* CRZHashTable<T>::createRoot(Args&&... args)
+{
+    T* root = Base::createRoot(std::forward<Args>(args)...);
+    storage->root.store(find(Base::currCode, Base::currKey), std::memory_order_relaxed);
+    return root;
+}
+
+template<typename T>
+template<class... Args>
+T* CRZHashTable<T>::updateRoot(unsigned moveIdx, Args&&... args){
+    // no synchronization is needed, function is not used concurrently
+    // old root is the first to be recycled
+    CHashNode* oldRoot = storage->root.load(std::memory_order_relaxed);
+    if(oldRoot)
+        oldRoot->visited.store(false, std::memory_order_relaxed);
+    T* root = select(moveIdx);
+    if(!root){
+        root = store(moveIdx, std::forward<Args>(args)...);
+        ++Base::rootDepth;
+    }
+    else
+        // Zobrist hashing
+        Base::updateRoot(moveIdx, root);
+    storage->root.store(found, std::memory_order_relaxed);
+    // tombstones increase the probe lengths
+    if(storage->tombstones.load(std::memory_order_relaxed) > storage->shardNum * storage->shardBudget)
+        rebuild();
+    return root;
+}
+
+template<typename T>
+void CRZHashTable<T>::rebuild()
+{
+    storage->tombstones.store(0, std::memory_order_relaxed);
+    for(unsigned shardIdx = 0; shardIdx < storage->shardNum; ++shardIdx){
+        Shard& shard = shards[shardIdx];
+        for(unsigned entryIdx = 0; entryIdx < storage->shardSize; ++entryIdx)
+            shard.table[entryIdx].store(EMPTY, std::memory_order_relaxed);
+        unsigned used = std::min<unsigned>(shard.used.load(std::memory_order_relaxed), storage->shardBudget);
+        for(unsigned nodeIdx = 0; nodeIdx < used; ++nodeIdx)
+            publish(shard, shard.nodes[nodeIdx].code, nodeIdx);
+    }
+}
+
+template<typename T>
+void CRZHashTable<T>::setupExploration(){
+    found = nullptr;
+}
+
+#endif // CRZHASHTABLE_H
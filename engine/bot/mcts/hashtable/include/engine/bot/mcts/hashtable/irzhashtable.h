@@ -0,0 +1,352 @@
+#ifndef IRZHASHTABLE_H
+#define IRZHASHTABLE_H
+
+#include "zhashtablebase.h"
+#include "nodearena.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**********************************************************************************
+ * Inline Recycling Zobrist HashTable                                             *
+ * - Same interface and node recycling semantics as RZHashTable, but the nodes    *
+ * are stored in the probed entries themselves, so a successful lookup touches a  *
+ * single entry instead of an entry and a list node                              *
+ * - Entries only store the node key, the hash code is derived from its lower     *
+ * bits. Two reserved key values mark empty entries and tombstones               *
+ * - Nodes can not be shifted like in RZHashTable as the search holds pointers to *
+ * them, recycled nodes become tombstones instead. store reuses the first         *
+ * tombstone of the probe sequence and tombstones followed by an empty entry are  *
+ * cleared right away, so they do not pile up                                     *
+ * - Every entry holds a node so the table should be sized close to 2 * budget    *
+ * - Entries of the children can be prefetched before they are scored             *
+ * - Only budget slices of per move arrays are reserved (see NodeArena), a new    *
+ * node takes over the slice of the node it recycles                              *
+ * - There is no heap allocation during the search phase                          *
+ **********************************************************************************/
+
+template<typename T>
+class IRZHashTable: public ZHashTableBase<IRZHashTable<T>>
+{
+public:
+    ZHASHTABLEBASE_SETUP(IRZHashTable<T>)
+
+    static constexpr bool prefetching = true;
+
+    IRZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=17, unsigned budget=50000);
+    ~IRZHashTable()=default;
+
+    IRZHashTable(const IRZHashTable&)=delete;
+    IRZHashTable& operator=(const IRZHashTable&)=delete;
+    IRZHashTable(IRZHashTable&&)=delete;
+    IRZHashTable& operator=(IRZHashTable&&)=delete;
+
+    // loads node, returns nullptr when it is not in the table
+    T* select(unsigned moveIdx);
+    template<class... Args>
+    T* store(unsigned moveIdx, Args&&... args);
+    // root needs to be overriden by the best child from the previous search
+    template<class... Args>
+    T* updateRoot(unsigned moveIdx, Args&&... args);
+
+    // overwrite base update function
+    void update(unsigned moveIdx, T* node);
+    // loads the entry of a child into the cache
+    void prefetch(unsigned moveIdx) const;
+
+    // table sharing the nodes with this one but following its own search path. Used by additional
+    // search threads, the caller is responsible for synchronizing the access to the shared nodes
+    IRZHashTable* createWorker();
+
+    NodeArena<T>& getArena();
+
+    // ---- table sizes (see tablesize.h) ----
+    // maximum ratio of the budget and the node capacity
+    static constexpr double MAXLOAD = 0.5;
+    // number of nodes the entries can hold
+    static size_t nodeCapacity(unsigned hashCodeSize);
+    // memory of a table with budget nodes
+    static size_t bytes(unsigned hashCodeSize, unsigned budget);
+
+protected:
+    IRZHashTable(IRZHashTable* owner);
+
+    // reserved keys, 0 is the key of the initial state
+    static constexpr ull EMPTYKEY = ~0ULL;
+    static constexpr ull TOMBSTONE = ~0ULL - 1;
+
+    struct Slot{
+        ull key = EMPTYKEY;
+        T impl;
+    };
+
+    // links of the fifo, indexed by entries
+    struct Link{
+        unsigned prev;
+        unsigned next;
+    };
+
+    // nodes and entries, shared with the worker tables
+    struct Storage{
+        std::vector<Slot> slots;
+        // least recently visited node to discard is at the beginning (next of the sentinel)
+        std::vector<Link> fifo;
+        // number of nodes in the fifo
+        unsigned size = 0;
+        NodeArena<T> arena;
+    };
+
+    // probes the entries from the code of the key, returns the entry of the node or NONE
+    // freeIdx stores the first empty entry or tombstone of the probe sequence
+    inline unsigned find(ull key);
+    // moves entry idx before entry pos in the fifo (like std::list::splice)
+    inline void splice(unsigned pos, unsigned idx);
+    // inserts entry idx before entry pos in the fifo
+    inline void link(unsigned pos, unsigned idx);
+    inline void unlink(unsigned idx);
+    // turns the entry of a recycled node into a tombstone
+    void remove(unsigned idx);
+    // entry holding a node
+    inline unsigned slotOf(const T* node) const;
+    // path nodes of the worker tables might be recycled by other threads
+    bool holds(const T* node) const;
+
+    void setupExploration();
+
+    // entry index of the fifo sentinel and no entry
+    const unsigned NONE;
+    const unsigned budget;
+
+    std::shared_ptr<Storage> storage;
+    std::vector<Slot>& slots;
+    std::vector<Link>& fifo;
+    // nodes are inserted before target in the fifo, see RZHashTable
+    unsigned target;
+    // entry found by the last lookup
+    unsigned idx;
+    // first free entry of the last lookup
+    unsigned freeIdx;
+};
+
+template<typename T>
+IRZHashTable<T>::IRZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned budget):
+    ZHashTableBase<IRZHashTable<T>>(moveNum, maxDepth, hashCodeSize),
+    NONE(pow(2, hashCodeSize)),
+    budget(budget),
+    storage(std::make_shared<Storage>()),
+    slots(storage->slots),
+    fifo(storage->fifo),
+    idx(NONE),
+    freeIdx(NONE)
+{
+    unsigned tableSize = pow(2, hashCodeSize);
+    if(tableSize < 2 * budget)
+        throw std::invalid_argument( "IRZHashTable: load factor should not exceed 0.5" );
+    if(budget < maxDepth + 1)
+        throw std::invalid_argument( "IRZHashTable: budget should be greater than " + std::to_string(maxDepth) );
+    slots = std::vector<Slot>(tableSize);
+    // empty circular list
+    fifo = std::vector<Link>(tableSize + 1, Link{NONE, NONE});
+    storage->arena.reserve(budget);
+    target = NONE;
+}
+
+template<typename T>
+IRZHashTable<T>::IRZHashTable(IRZHashTable* owner):
+    ZHashTableBase<IRZHashTable<T>>(owner),
+    NONE(owner->NONE),
+    budget(owner->budget),
+    storage(owner->storage),
+    slots(storage->slots),
+    fifo(storage->fifo),
+    idx(NONE),
+    freeIdx(NONE)
+{
+    setupExploration();
+}
+
+template<typename T>
+IRZHashTable<T>* IRZHashTable<T>::createWorker()
+{
+    return new IRZHashTable(this);
+}
+
+template<typename T>
+NodeArena<T>& IRZHashTable<T>::getArena()
+{
+    return storage->arena;
+}
+
+template<typename T>
+size_t IRZHashTable<T>::nodeCapacity(unsigned hashCodeSize)
+{
+    return (size_t(1) << hashCodeSize);
+}
+
+template<typename T>
+size_t IRZHashTable<T>::bytes(unsigned hashCodeSize, unsigned budget)
+{
+    // entries holding the nodes and their links
+    return (size_t(1) << hashCodeSize) * (sizeof(Slot) + sizeof(Link)) + sizeof(Link) + NodeArena<T>::bytes(budget);
+}
+
+template<typename T>
+inline unsigned IRZHashTable<T>::find(ull key)
+{
+    ull code = key & Base::hashCodeMask;
+    freeIdx = NONE;
+    // linear probing
+    // there is no infinite loop as the number of nodes are strictly smaller than the number of entries
+    // but tombstones might fill up the rest so probing stops after a whole round
+    for(ull steps = 0; steps <= Base::hashCodeMask; ++steps){
+        ull slotKey = slots[code].key;
+        if(slotKey == key)
+            return code;
+        if(slotKey == EMPTYKEY){
+            if(freeIdx == NONE)
+                freeIdx = code;
+            return NONE;
+        }
+        if(slotKey == TOMBSTONE && freeIdx == NONE)
+            freeIdx = code;
+        code = (code + 1) & Base::hashCodeMask;
+    }
+    return NONE;
+}
+
+template<typename T>
+inline void IRZHashTable<T>::link(unsigned pos, unsigned idx){
+    unsigned prev = fifo[pos].prev;
+    fifo[idx] = {prev, pos};
+    fifo[prev].next = idx;
+    fifo[pos].prev = idx;
+}
+
+template<typename T>
+inline void IRZHashTable<T>::unlink(unsigned idx){
+    fifo[fifo[idx].prev].next = fifo[idx].next;
+    fifo[fifo[idx].next].prev = fifo[idx].prev;
+}
+
+template<typename T>
+inline void IRZHashTable<T>::splice(unsigned pos, unsigned idx){
+    if(pos == idx || fifo[idx].next == pos)
+        return;
+    unlink(idx);
+    link(pos, idx);
+}
+
+template<typename T>
+void IRZHashTable<T>::remove(unsigned idx){
+    slots[idx].key = TOMBSTONE;
+    // probe sequences do not pass through a tombstone followed by an empty entry
+    if(slots[(idx + 1) & Base::hashCodeMask].key != EMPTYKEY)
+        return;
+    while(slots[idx].key == TOMBSTONE){
+        slots[idx].key = EMPTYKEY;
+        idx = (idx - 1) & Base::hashCodeMask;
+    }
+}
+
+template<typename T>
+inline unsigned IRZHashTable<T>::slotOf(const T* node) const
+{
+    return (reinterpret_cast<const char*>(node) - reinterpret_cast<const char*>(std::addressof(slots[0].impl))) / sizeof(Slot);
+}
+
+template<typename T>
+bool IRZHashTable<T>::holds(const T* node) const
+{
+    return slots[slotOf(node)].key == Base::currKey;
+}
+
+template<typename T>
+T* IRZHashTable<T>::select(unsigned moveIdx)
+{
+    // see RZHashTable::select for the case of 2 states mapped to the same entry with the same hashKey
+    idx = find(Base::currKey ^ Base::hashKeys[moveIdx]);
+    return idx == NONE ? nullptr : std::addressof(slots[idx].impl);
+}
+
+template<typename T>
+void IRZHashTable<T>::prefetch(unsigned moveIdx) const
+{
+    __builtin_prefetch(std::addressof(slots[(Base::currKey ^ Base::hashKeys[moveIdx]) & Base::hashCodeMask]));
+}
+
+template<typename T>
+void IRZHashTable<T>::update(unsigned moveIdx, T* node)
+{
+    // Zobrist hashing
+    Base::update(moveIdx, node);
+    // update position in fifo
+    idx = slotOf(node);
+    splice(target, idx);
+    target = idx;
+}
+
+template<typename T>
+template<class... Args>
+T* IRZHashTable<T>::store(unsigned moveIdx, Args&&... args)
+{
+    T* node = select(moveIdx);
+    // Zobrist hashing
+    Base::update(moveIdx);
+
+    if(node)
+        return Base::track(node);
+
+    // recycle the least recently visited node when the budget is used up
+    if(storage->size < budget){
+        ++storage->size;
+        idx = freeIdx;
+        storage->arena.bind(slots[idx].impl);
+    }
+    else{
+        unsigned recycled = fifo[NONE].next;
+        unlink(recycled);
+        remove(recycled);
+        // the recycled entry might have been cleared on the probe sequence of the new node
+        find(Base::currKey);
+        idx = freeIdx;
+        storage->arena.move(slots[recycled].impl, slots[idx].impl);
+    }
+    slots[idx].key = Base::currKey;
+    slots[idx].impl.reset(std::forward<Args>(args)...);
+    link(target, idx);
+    return Base::track(std::addressof(slots[idx].impl));
+}
+
+template<typename T>
+template<class... Args>
+T* IRZHashTable<T>::updateRoot(unsigned moveIdx, Args&&... args){
+    // no synchronization is needed, function is not used concurrently
+    T* root = select(moveIdx);
+
+    // move old root to the beginning of fifo to be overridden
+    splice(fifo[NONE].next, fifo[NONE].prev);
+    // if new root is not in table
+    if(!root){
+        target = NONE; // root will be the last in fifo
+        root = store(moveIdx, std::forward<Args>(args)...);
+        // selected node will be moved in front of the root in the FIFO
+        target = fifo[NONE].prev;
+        ++Base::rootDepth;
+    }
+    else{
+        // Zobrist hashing
+        Base::updateRoot(moveIdx, root);
+        // move new root to the last position
+        splice(NONE, idx);
+        target = idx;
+    }
+    return root;
+}
+
+template<typename T>
+void IRZHashTable<T>::setupExploration(){
+    target = fifo[NONE].prev;
+}
+
+#endif // IRZHASHTABLE_H
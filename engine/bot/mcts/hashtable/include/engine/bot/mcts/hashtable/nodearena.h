@@ -0,0 +1,185 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include "pageallocator.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/**********************************************************************************
+ * Arena of node slices owned by the hashtables                                   *
+ * - Nodes storing an array per move (like the AMAF statistics of RAVENode or     *
+ * the child visit counts of UCTNode) get a fixed-size slice of the arena of      *
+ * their table instead of owning vectors                                          *
+ * - Requirements on node type T to use an arena:                                 *
+ *   typedef slice_type: trivial type of the array elements                       *
+ *   static unsigned sliceSize(): number of elements in a slice                   *
+ *   void bind(unsigned slice), unsigned getSlice(): slice handle of the node     *
+ * Other nodes get an empty arena                                                 *
+ * - Slices are referenced by 32 bit handles (chunk and index within the chunk)   *
+ * instead of pointers, so the arena can live in memory mapped at different       *
+ * addresses (like shared memory)                                                 *
+ * - The arena grows by chunks of 2^16 slices. Tables with a node budget reserve  *
+ * all the slices up front so there is no allocation during the search phase      *
+ * - Chunks can be mapped on huge pages (see PageAllocator)                       *
+ **********************************************************************************/
+
+template<typename T, typename = void>
+class NodeArena
+{
+public:
+    NodeArena(bool=false){}
+    NodeArena(void*, unsigned){}
+
+    NodeArena(const NodeArena&)=delete;
+    NodeArena& operator=(const NodeArena&)=delete;
+    NodeArena(NodeArena&&)=delete;
+    NodeArena& operator=(NodeArena&&)=delete;
+
+    void reserve(unsigned){}
+    void bind(T&){}
+    void move(const T&, T&){}
+    size_t getBytes() const { return 0; }
+    // bytes of the external memory needed for capacity slices
+    static size_t bytes(unsigned){ return 0; }
+};
+
+template<typename T>
+class NodeArena<T, std::void_t<typename T::slice_type>>
+{
+public:
+    typedef typename T::slice_type V;
+    static_assert(std::is_trivial_v<V>, "NodeArena: slice elements should be trivial");
+
+    NodeArena(bool hugePages=false);
+    // slices in external memory of bytes(capacity) size (like shared memory), the arena can not grow
+    NodeArena(void* memory, unsigned capacity);
+    ~NodeArena()=default;
+
+    NodeArena(const NodeArena&)=delete;
+    NodeArena& operator=(const NodeArena&)=delete;
+    NodeArena(NodeArena&&)=delete;
+    NodeArena& operator=(NodeArena&&)=delete;
+
+    // allocates capacity slices before the first one is handed out, the memory is not initialized
+    void reserve(unsigned capacity);
+    // hands out a new slice to the node
+    void bind(T& node);
+    // hands over the slice of a node that is not used anymore (like a recycled one)
+    void move(const T& from, T& to);
+
+    inline V* get(unsigned slice) const;
+    size_t getBytes() const;
+    static size_t bytes(unsigned capacity);
+
+private:
+    static constexpr unsigned CHUNKBITS = 16;
+    static constexpr unsigned CHUNKMASK = (1u << CHUNKBITS) - 1;
+
+    void addChunk(unsigned chunkSize);
+
+    // returns the slices of an owned chunk to the allocator
+    struct Deleter{
+        PageAllocator<V> allocator;
+        size_t size;
+        void operator()(V* slices){ allocator.deallocate(slices, size); }
+    };
+
+    const unsigned sliceSize;
+    std::vector<V*> chunks;
+    PageAllocator<V> allocator;
+    std::vector<std::unique_ptr<V, Deleter>> owned;
+    // handle of the next slice
+    unsigned next;
+    // slices available without allocation
+    unsigned capacity;
+    // number of allocated slices
+    unsigned allocated;
+    const bool external;
+};
+
+template<typename T>
+NodeArena<T, std::void_t<typename T::slice_type>>::NodeArena(bool hugePages):
+    sliceSize(T::sliceSize()),
+    allocator(hugePages),
+    next(0),
+    capacity(0),
+    allocated(0),
+    external(false)
+{
+}
+
+template<typename T>
+NodeArena<T, std::void_t<typename T::slice_type>>::NodeArena(void* memory, unsigned capacity):
+    sliceSize(T::sliceSize()),
+    next(0),
+    capacity(capacity),
+    allocated(capacity),
+    external(true)
+{
+    V* slices = static_cast<V*>(memory);
+    for(unsigned first = 0; first < capacity; first += CHUNKMASK + 1)
+        chunks.push_back(slices + static_cast<size_t>(first) * sliceSize);
+}
+
+template<typename T>
+void NodeArena<T, std::void_t<typename T::slice_type>>::addChunk(unsigned chunkSize)
+{
+    if(external)
+        throw std::runtime_error( "NodeArena: external arena is full" );
+    if(chunks.size() > (~0u >> CHUNKBITS))
+        throw std::runtime_error( "NodeArena: number of slices exceeds the handle range" );
+    // partially allocated last chunk is skipped
+    next = chunks.size() << CHUNKBITS;
+    // slices are trivial, the memory is not initialized
+    size_t size = static_cast<size_t>(chunkSize) * sliceSize;
+    owned.emplace_back(allocator.allocate(size), Deleter{allocator, size});
+    chunks.push_back(owned.back().get());
+    capacity = next + chunkSize;
+    allocated += chunkSize;
+}
+
+template<typename T>
+void NodeArena<T, std::void_t<typename T::slice_type>>::reserve(unsigned capacity)
+{
+    while((static_cast<unsigned>(chunks.size()) << CHUNKBITS) < capacity)
+        addChunk(std::min(CHUNKMASK + 1, capacity - (static_cast<unsigned>(chunks.size()) << CHUNKBITS)));
+    next = 0;
+}
+
+template<typename T>
+void NodeArena<T, std::void_t<typename T::slice_type>>::bind(T& node)
+{
+    if(next >= capacity)
+        addChunk(CHUNKMASK + 1);
+    node.bind(next++);
+}
+
+template<typename T>
+void NodeArena<T, std::void_t<typename T::slice_type>>::move(const T& from, T& to)
+{
+    to.bind(from.getSlice());
+}
+
+template<typename T>
+inline typename NodeArena<T, std::void_t<typename T::slice_type>>::V* NodeArena<T, std::void_t<typename T::slice_type>>::get(unsigned slice) const
+{
+    return chunks[slice >> CHUNKBITS] + static_cast<size_t>(slice & CHUNKMASK) * sliceSize;
+}
+
+template<typename T>
+size_t NodeArena<T, std::void_t<typename T::slice_type>>::getBytes() const
+{
+    return static_cast<size_t>(allocated) * sliceSize * sizeof(V);
+}
+
+template<typename T>
+size_t NodeArena<T, std::void_t<typename T::slice_type>>::bytes(unsigned capacity)
+{
+    return static_cast<size_t>(capacity) * T::sliceSize() * sizeof(V);
+}
+
+#endif // NODEARENA_H
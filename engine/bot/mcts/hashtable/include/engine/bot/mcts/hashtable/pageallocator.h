@@ -0,0 +1,90 @@
+#ifndef PAGEALLOCATOR_H
+#define PAGEALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include <sys/mman.h>
+
+/**********************************************************************************
+ * Allocator of the table and node storage                                        *
+ * - By default it is std::allocator                                              *
+ * - With huge pages the arrays of at least 2 MB are mapped on 2 MB pages so      *
+ * random probes of large tables need a lot less TLB entries. Explicit huge pages *
+ * (MAP_HUGETLB) are used when the system has reserved ones, otherwise the memory *
+ * is mapped on normal pages and the kernel is asked to back it with transparent  *
+ * huge pages (MADV_HUGEPAGE). When that is not supported either, the mapping     *
+ * stays on normal pages                                                          *
+ * - Mappings are rounded up to 2 MB and aligned to 2 MB                          *
+ **********************************************************************************/
+
+template<typename V>
+class PageAllocator
+{
+public:
+    typedef V value_type;
+
+    PageAllocator(bool hugePages=false) noexcept: hugePages(hugePages){}
+    template<typename U>
+    PageAllocator(const PageAllocator<U>& other) noexcept: hugePages(other.hugePages){}
+
+    V* allocate(size_t n);
+    void deallocate(V* p, size_t n) noexcept;
+
+    template<typename U>
+    bool operator==(const PageAllocator<U>& other) const noexcept { return hugePages == other.hugePages; }
+    template<typename U>
+    bool operator!=(const PageAllocator<U>& other) const noexcept { return hugePages != other.hugePages; }
+
+    static constexpr size_t HUGEPAGESIZE = size_t(1) << 21;
+
+private:
+    template<typename U>
+    friend class PageAllocator;
+
+    // smaller arrays would waste most of a huge page
+    bool mapped(size_t n) const noexcept { return hugePages && n * sizeof(V) >= HUGEPAGESIZE; }
+    static size_t roundUp(size_t n) noexcept { return (n * sizeof(V) + HUGEPAGESIZE - 1) & ~(HUGEPAGESIZE - 1); }
+
+    bool hugePages;
+};
+
+template<typename V>
+V* PageAllocator<V>::allocate(size_t n)
+{
+    if(!mapped(n))
+        return std::allocator<V>().allocate(n);
+    size_t bytes = roundUp(n);
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if(p == MAP_FAILED){
+        // huge pages are only used for 2 MB aligned ranges, the unaligned head and tail are unmapped
+        char* raw = static_cast<char*>(mmap(nullptr, bytes + HUGEPAGESIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if(raw == MAP_FAILED)
+            throw std::bad_alloc();
+        char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + HUGEPAGESIZE - 1) & ~(HUGEPAGESIZE - 1));
+        if(aligned != raw)
+            munmap(raw, aligned - raw);
+        munmap(aligned + bytes, raw + HUGEPAGESIZE - aligned);
+        p = aligned;
+#ifdef MADV_HUGEPAGE
+        madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    return static_cast<V*>(p);
+}
+
+template<typename V>
+void PageAllocator<V>::deallocate(V* p, size_t n) noexcept
+{
+    if(!mapped(n))
+        std::allocator<V>().deallocate(p, n);
+    else
+        munmap(p, roundUp(n));
+}
+
+#endif // PAGEALLOCATOR_H
@@ -2,10 +2,12 @@
 #define RZHASHTABLE_H
 
 #include "zhashtablebase.h"
+#include "nodearena.h"
+#include "pageallocator.h"
 
 #include <algorithm>
-#include <list>
 #include <memory>
+#include <vector>
 
 /**********************************************************************************
  * Recycling Zobrist HashTable                                                    *
@@ -18,7 +20,16 @@
  * than the # of insertions/deletions during a Monte Carlo tree search, we        *
  * immetiately fill up deleted entries so the probability of finding an item      *
  * right away is the maximum (~ 1-1/(load factor))                                *
+ * - The recycling order is an intrusive doubly linked list over a contiguous node *
+ * array with 32 bit links, table entries are 32 bit node indices                 *
+ * - Per move arrays of the nodes (see NodeArena) are reserved with the nodes     *
  * - There is no heap allocation during the search phase                          *
+ * - Entries, nodes and per move arrays can be mapped on huge pages to reduce the *
+ * TLB misses of the random probes with large budgets (see PageAllocator)         *
+ * - Nodes stay at their indices, so their parents can cache the indices of the   *
+ * children (edges), a recycled node is detected by its key                       *
+ * - The selected children are given to update and the probe of a missing child   *
+ * remembers where it ended, so neither update nor store probes the table again   *
  **********************************************************************************/
 
 template<typename T>
@@ -27,7 +38,7 @@ class RZHashTable: public ZHashTableBase<RZHashTable<T>>
 public:
     ZHASHTABLEBASE_SETUP(RZHashTable<T>)
 
-    RZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=20, unsigned budget=50000);
+    RZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=20, unsigned budget=50000, bool hugePages=false);
     ~RZHashTable()=default;
 
     RZHashTable(const RZHashTable&)=delete;
@@ -35,8 +46,13 @@ public:
     RZHashTable(RZHashTable&&)=delete;
     RZHashTable& operator=(RZHashTable&&)=delete;
 
+    static constexpr bool edges = true;
+
     // loads node, returns nullptr when it is not in the table
     T* select(unsigned moveIdx);
+    // loads node from the cached index of the caller (edge) when it still holds the node, probes the table and
+    // updates the edge otherwise
+    T* select(unsigned moveIdx, uint32_t& edge);
     template<class... Args>
     T* store(unsigned moveIdx, Args&&... args);
     // root needs to be overriden by the best child from the previous search
@@ -44,86 +60,219 @@ public:
     T* updateRoot(unsigned moveIdx, Args&&... args);
 
     // overwrite base update function
-    void update(unsigned moveIdx);
+    void update(unsigned moveIdx, T* node);
+
+    // table sharing the nodes with this one but following its own search path. Used by additional
+    // search threads, the caller is responsible for synchronizing the access to the shared nodes
+    RZHashTable* createWorker();
+
+    // per move arrays of the nodes, each node keeps its slice when it is recycled
+    NodeArena<T>& getArena();
+
+    // ---- table sizes (see tablesize.h) ----
+    // maximum ratio of the budget and the node capacity
+    static constexpr double MAXLOAD = 0.5;
+    // number of nodes the entries can hold
+    static size_t nodeCapacity(unsigned hashCodeSize);
+    // memory of a table with budget nodes
+    static size_t bytes(unsigned hashCodeSize, unsigned budget);
 
 protected:
+    RZHashTable(RZHashTable* owner);
+
     // the last 2 table entries (are not addressable) are stored as dummy entries so we can use them as flags
     // and to initialize the table so no valid entries are overridden in store function at the begining
     // this way we can spare an if statement in the store function
     // node is empty when the node code is the index for the last entry
-    bool isEmpty(const typename std::list<HashNode>::iterator& it) const;
-    void setEmpty(typename std::list<HashNode>::iterator& it);
+    bool isEmpty(unsigned idx) const;
+
+    // moves node idx before node pos in the fifo (like std::list::splice)
+    inline void splice(unsigned pos, unsigned idx);
+    // index of a node of the table
+    inline unsigned indexOf(const T* node) const;
+    // path nodes of the worker tables might be recycled by other threads
+    bool holds(const T* node) const;
 
     void setupExploration();
 
     // empty code
     const ull EMPTYCODE;
-    // empty node
-    inline static std::list<HashNode> empty;
-
-    // least recently visited node to discard is at the beginning
-    // technically not a fifo because we need to move interior nodes to the end each time they are visited
-    inline static std::list<HashNode> fifo;
-    // maps hash values to iterators in the fifo
-    std::vector<typename std::list<HashNode>::iterator> table;
+    // index of the empty node, it is also the sentinel of the fifo (its end)
+    const unsigned EMPTY;
+
+    // links of the fifo
+    struct Link{
+        unsigned prev;
+        unsigned next;
+    };
+
+    template<typename V>
+    using Vector = std::vector<V, PageAllocator<V>>;
+
+    // nodes and entries, shared with the worker tables
+    struct Storage{
+        Storage(bool hugePages):
+        nodes(PageAllocator<HashNode>(hugePages)),
+        fifo(PageAllocator<Link>(hugePages)),
+        table(PageAllocator<unsigned>(hugePages)),
+        arena(hugePages){}
+
+        // the nodes to recycle followed by the empty node
+        Vector<HashNode> nodes;
+        // least recently visited node to discard is at the beginning (next of the sentinel)
+        // technically not a fifo because we need to move interior nodes to the end each time they are visited
+        Vector<Link> fifo;
+        // maps hash values to node indices
+        Vector<unsigned> table;
+        NodeArena<T> arena;
+    };
+    std::shared_ptr<Storage> storage;
+    Vector<HashNode>& nodes;
+    Vector<Link>& fifo;
+    Vector<unsigned>& table;
     // we update the fifo during the selection phase (visited ones should go to the back)
     // in the selection phase nodes need to be inserted before their parents and target stores that location
     // alternatively we could do it during backpropagation (so nodes just can be pushed to the back)
-    // but this way the caller do not need to rely on a stack storing the moves/nodes
-    // and the fifo member can be better parallelized
-    typename std::list<HashNode>::iterator target;
+    // but this way the fifo member can be better parallelized
+    unsigned target;
 
     // code stores the result (hash value) from the last linear probing
     // so later we can store the new node at the proper location
     ull code;
+
+    // end of the last probe of a missing child, store inserts the child there while the table is unchanged
+    struct Miss{
+        ull key;
+        ull code;
+        unsigned stamp;
+    };
+    std::vector<Miss> misses;
+    // changed by every store and search cycle of the table, misses of other stamps are outdated
+    unsigned stamp;
 };
 
 template<typename T>
-RZHashTable<T>::RZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned budget):
+RZHashTable<T>::RZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned budget, bool hugePages):
     ZHashTableBase<RZHashTable<T>>(moveNum, maxDepth, hashCodeSize),
     EMPTYCODE(pow(2, hashCodeSize)),
-    code(0)
+    EMPTY(budget),
+    storage(std::make_shared<Storage>(hugePages)),
+    nodes(storage->nodes),
+    fifo(storage->fifo),
+    table(storage->table),
+    code(0),
+    misses(moveNum, Miss{0, 0, 0}),
+    stamp(1)
 {
     unsigned tableSize = pow(2, hashCodeSize);
     if(tableSize < 2 * budget)
         throw std::invalid_argument( "RZHashTable: load factor should not exceed 0.5" );
     if(budget < maxDepth + 1)
         throw std::invalid_argument( "RZHashTable: budget should be greater than " + std::to_string(maxDepth) );
-    empty = std::list<HashNode>(1, HashNode(0, EMPTYCODE));
-    fifo = std::list<HashNode>(budget, HashNode(0, EMPTYCODE)); // preallocate nodes
+    // preallocate nodes, the last one is the empty node
+    nodes.assign(budget + 1, HashNode(0, EMPTYCODE));
+    storage->arena.reserve(budget + 1);
+    for(auto& node : nodes)
+        storage->arena.bind(node.impl);
+    // circular list in the order of the nodes
+    fifo.resize(budget + 1);
+    for(unsigned idx = 0; idx <= budget; ++idx)
+        fifo[idx] = {idx == 0 ? budget : idx - 1, idx == budget ? 0 : idx + 1};
 
     // last is root
-    fifo.back().code = 0;
+    nodes[budget - 1].code = 0;
     // next insertion before root
-    target = fifo.end();
-    --target;
+    target = budget - 1;
 
     // +2 additional dummy entries at the end
-    table = std::vector<typename std::list<HashNode>::iterator>(tableSize + 2, empty.begin());
+    table.assign(tableSize + 2, EMPTY);
     table[Base::currCode] = target; // set root in table
 }
 
 template<typename T>
-inline bool RZHashTable<T>::isEmpty(const typename std::list<HashNode>::iterator& it) const{
-    return it == empty.begin();
+RZHashTable<T>::RZHashTable(RZHashTable* owner):
+    ZHashTableBase<RZHashTable<T>>(owner),
+    EMPTYCODE(owner->EMPTYCODE),
+    EMPTY(owner->EMPTY),
+    storage(owner->storage),
+    nodes(storage->nodes),
+    fifo(storage->fifo),
+    table(storage->table),
+    code(0),
+    misses(owner->misses.size(), Miss{0, 0, 0}),
+    stamp(1)
+{
+    setupExploration();
+}
+
+template<typename T>
+RZHashTable<T>* RZHashTable<T>::createWorker()
+{
+    return new RZHashTable(this);
+}
+
+template<typename T>
+NodeArena<T>& RZHashTable<T>::getArena()
+{
+    return storage->arena;
+}
+
+template<typename T>
+size_t RZHashTable<T>::nodeCapacity(unsigned hashCodeSize)
+{
+    return (size_t(1) << hashCodeSize);
+}
+
+template<typename T>
+size_t RZHashTable<T>::bytes(unsigned hashCodeSize, unsigned budget)
+{
+    // entries, nodes with the empty node and their links
+    return ((size_t(1) << hashCodeSize) + 2) * sizeof(unsigned) + (budget + size_t(1)) * (sizeof(HashNode) + sizeof(Link)) +
+           NodeArena<T>::bytes(budget + 1);
+}
+
+template<typename T>
+inline bool RZHashTable<T>::isEmpty(unsigned idx) const{
+    return idx == EMPTY;
 }
 
 template<typename T>
-inline void RZHashTable<T>::setEmpty(typename std::list<HashNode>::iterator& it) {
-    it = empty.begin();
+inline void RZHashTable<T>::splice(unsigned pos, unsigned idx){
+    if(pos == idx || fifo[idx].next == pos)
+        return;
+    // unlink
+    fifo[fifo[idx].prev].next = fifo[idx].next;
+    fifo[fifo[idx].next].prev = fifo[idx].prev;
+    // link before pos
+    unsigned prev = fifo[pos].prev;
+    fifo[idx] = {prev, pos};
+    fifo[prev].next = idx;
+    fifo[pos].prev = idx;
+}
+
+template<typename T>
+inline unsigned RZHashTable<T>::indexOf(const T* node) const
+{
+    return (reinterpret_cast<const char*>(node) - reinterpret_cast<const char*>(std::addressof(nodes[0].impl))) / sizeof(HashNode);
+}
+
+template<typename T>
+bool RZHashTable<T>::holds(const T* node) const
+{
+    return nodes[indexOf(node)].key == Base::currKey;
 }
 
 template<typename T>
 T* RZHashTable<T>::select(unsigned moveIdx)
 {
     code = Base::currCode ^ Base::hashCodes[moveIdx];
-    auto it = table[code];
+    unsigned idx = table[code];
     // linear probing
     // there is no infinite loop as the number of
     // nodes are strictly smaller than the number of entries
-    while(!isEmpty(it)) {
+    while(!isEmpty(idx)) {
         // node is in the table
-        if(it->key == (Base::currKey ^ Base::hashKeys[moveIdx])){
+        if(nodes[idx].key == (Base::currKey ^ Base::hashKeys[moveIdx])){
             /**
                There is almost zero probability that 2 states from the current selection path will be mapped
                to the same entry with the same hashKey. But when it happens we
@@ -139,72 +288,77 @@ T* RZHashTable<T>::select(unsigned moveIdx)
             **/
 
             // in case Ts' & operator is overloaded
-            // * operator gives reference
-            return std::addressof(it->impl);
+            return std::addressof(nodes[idx].impl);
         }
         code = (code + 1) & Base::hashCodeMask;
-        it = table[code];
+        idx = table[code];
     }
     // node is not in the table
+    misses[moveIdx] = {Base::currKey ^ Base::hashKeys[moveIdx], code, stamp};
     return nullptr;
 }
 
 template<typename T>
-void RZHashTable<T>::update(unsigned moveIdx)
+T* RZHashTable<T>::select(unsigned moveIdx, uint32_t& edge)
 {
-    // Zobrist hashing
-    Base::update(moveIdx);
-    code = Base::currCode;
-    auto it = table[code];
-    while(!isEmpty(it)) {
-        // node is in the table
-        if(it->key == Base::currKey){
+    // nodes are not moved, the node holding the key of the child is the child until it is recycled
+    if(nodes[edge].key == (Base::currKey ^ Base::hashKeys[moveIdx]))
+        return std::addressof(nodes[edge].impl);
+    T* node = select(moveIdx);
+    // code is the entry of the node after a successful probe
+    if(node)
+        edge = table[code];
+    return node;
+}
 
-            // in case Ts' & operator is overloaded
-            // * operator gives reference
-            // update position in fifo
-            fifo.splice(target, fifo, it);
-            target = it;
-            return;
-        }
-        code = (code + 1) & Base::hashCodeMask;
-        it = table[code];
-    }
+template<typename T>
+void RZHashTable<T>::update(unsigned moveIdx, T* node)
+{
+    // Zobrist hashing
+    Base::update(moveIdx, node);
+    // update position in fifo
+    unsigned idx = indexOf(node);
+    splice(target, idx);
+    target = idx;
 }
 
 template<typename T>
 template<class... Args>
 T* RZHashTable<T>::store(unsigned moveIdx, Args&&... args)
 {
-    // update code
-    T* node = select(moveIdx);
+    // the selection has already probed the entries of the child
+    const Miss& miss = misses[moveIdx];
+    if(miss.stamp == stamp && miss.key == (Base::currKey ^ Base::hashKeys[moveIdx]))
+        code = miss.code;
+    else if(T* node = select(moveIdx)){
+        Base::update(moveIdx);
+        return Base::track(node);
+    }
     // Zobrist hashing
     Base::update(moveIdx);
+    ++stamp;
 
-    if(node)
-        return node;
-
-    auto it = fifo.begin();
+    unsigned idx = fifo[EMPTY].next;
 
     // get location of node to remove
     ull targetCode, sourceCode;
-    targetCode = fifo.front().code;
+    targetCode = nodes[idx].code;
 
     // to restore dummy address, only bit manipulation, no if is needed
     ull ov = targetCode & ~Base::hashCodeMask;
     // find exact location
-    while(table[targetCode]->key != fifo.front().key)
+    while(nodes[table[targetCode]].key != nodes[idx].key)
         targetCode = (targetCode + 1) & Base::hashCodeMask;
     sourceCode = (targetCode + 1) & Base::hashCodeMask | ov;
 
     // update position in fifo
-    fifo.splice(target, fifo, it);
+    splice(target, idx);
 
     // we insert before shifting so we do not need to check if we need to shift it afterwards
     // override the least recently visited leaf node by the new one
-    it->reset(Base::currKey, Base::currCode, std::forward<Args>(args)...);
-    // set the iterator in the hash table
-    table[code] = it;
+    nodes[idx].reset(Base::currKey, Base::currCode, std::forward<Args>(args)...);
+    // set the index in the hash table
+    table[code] = idx;
 
     // ---- remove least recently visited leaf from hashtable ----
 
@@ -215,9 +369,10 @@ T* RZHashTable<T>::store(unsigned moveIdx, Args&&... args)
     while(!isEmpty(table[sourceCode])) {
         // check if we can shift from source (that is hashcode is between the target and its current location)
         // normal in-between comparison would not work because of overflow
+        ull shiftCode = nodes[table[sourceCode]].code;
         if(sourceCode < targetCode ?
-           (table[sourceCode]->code <= targetCode && table[sourceCode]->code > sourceCode) :
-           (table[sourceCode]->code <= targetCode || table[sourceCode]->code > sourceCode))
+           (shiftCode <= targetCode && shiftCode > sourceCode) :
+           (shiftCode <= targetCode || shiftCode > sourceCode))
         {
             table[targetCode] = table[sourceCode];
             targetCode = sourceCode;
@@ -225,8 +380,8 @@ T* RZHashTable<T>::store(unsigned moveIdx, Args&&... args)
         sourceCode = (sourceCode + 1) & Base::hashCodeMask;
     }
     // set last source entry to empty to remove duplication or the first one if there was no shift
-    setEmpty(table[targetCode]);
-    return std::addressof(it->impl);
+    table[targetCode] = EMPTY;
+    return Base::track(std::addressof(nodes[idx].impl));
 }
 
 template<typename T>
@@ -234,39 +389,38 @@ template<class... Args>
 T* RZHashTable<T>::updateRoot(unsigned moveIdx, Args&&... args){
     // no synchronization is needed, function is not used concurrently
     code = Base::currCode ^ Base::hashCodes[moveIdx];
-    auto it = table[code];
-    while(!isEmpty(it) && it->key != (Base::currKey ^ Base::hashKeys[moveIdx])) {
+    unsigned idx = table[code];
+    while(!isEmpty(idx) && nodes[idx].key != (Base::currKey ^ Base::hashKeys[moveIdx])) {
         code = (code + 1) & Base::hashCodeMask;
-        it = table[code];
+        idx = table[code];
     }
 
     // move old root to the beginning of fifo to be overridden
-    auto root = fifo.end();
-    --root;
-    fifo.splice(fifo.begin(), fifo, root);
+    splice(fifo[EMPTY].next, fifo[EMPTY].prev);
     // if new root is not in table
-    if(isEmpty(it)){
-        target = fifo.end(); // root will be the last in fifo
+    if(isEmpty(idx)){
+        target = EMPTY; // root will be the last in fifo
         T* root = store(moveIdx, std::forward<Args>(args)...);
         // selected node will be moved in front of the root in the FIFO
-        --target;
+        target = fifo[EMPTY].prev;
         ++Base::rootDepth;
         return root;
     }
     else{
         // Zobrist hashing
-        Base::updateRoot(moveIdx);
+        Base::updateRoot(moveIdx, std::addressof(nodes[idx].impl));
         // move new root to the last position
-        fifo.splice(fifo.end(), fifo, it);
-        target = it;
-        return std::addressof(it->impl);
+        splice(EMPTY, idx);
+        target = idx;
+        return std::addressof(nodes[idx].impl);
     }
 }
 
 template<typename T>
 void RZHashTable<T>::setupExploration(){
-    target = fifo.end();
-    --target;
+    target = fifo[EMPTY].prev;
+    // other threads might have changed the shared entries since the last search cycle
+    ++stamp;
 }
 
 #endif // RZHASHTABLE_H
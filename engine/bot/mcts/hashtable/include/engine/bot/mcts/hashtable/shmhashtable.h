@@ -0,0 +1,509 @@
+#ifndef SHMHASHTABLE_H
+#define SHMHASHTABLE_H
+
+#include "zhashtablebase.h"
+#include "nodearena.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**********************************************************************************
+ * Shared-memory Recycling Zobrist HashTable                                      *
+ * - Entries and nodes live in a POSIX shared memory object so several engine     *
+ * processes on the same host can search into a single tree (lazy SMP style).     *
+ * The first table creates the object, the others attach to it. It is removed     *
+ * when the last table is destroyed                                               *
+ * - Zobrist hash codes and keys are generated from a seed stored in the shared   *
+ * object so every process maps the states to the same entries                    *
+ * - Recycling and the lock-free entry updates follow CRZHashTable. Entries are   *
+ * 64 bit words holding the node index and the upper half of the node key so     *
+ * most mismatches are rejected without touching the node                         *
+ * - The node key is verified on every lookup and it is cleared while a node is   *
+ * being recycled, so lookups do not match half overwritten nodes                 *
+ * - Nodes should be trivially copyable: they can not own heap memory or point    *
+ * to memory that is not shared. Per move arrays of the nodes (see NodeArena) are *
+ * placed after the nodes and referenced by slice handles                         *
+ * - Node statistics are not synchronized between processes. Updates might be    *
+ * lost when processes update the same node at the same time                      *
+ **********************************************************************************/
+
+template<typename T>
+class SHMHashTable: public ZHashTableBase<SHMHashTable<T>>
+{
+    static_assert(std::is_trivially_copyable_v<T>, "SHMHashTable: nodes stored in shared memory should be trivially copyable");
+    static_assert(std::atomic<unsigned long long>::is_always_lock_free && std::atomic<unsigned>::is_always_lock_free,
+                  "SHMHashTable: atomics in shared memory should be lock-free");
+public:
+    ZHASHTABLEBASE_SETUP(SHMHashTable<T>)
+
+    // name: name of the shared memory object, tables of the same name should be created with the same parameters
+    SHMHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=20, unsigned budget=50000, std::string name="/mcts");
+    ~SHMHashTable()=default;
+
+    SHMHashTable(const SHMHashTable&)=delete;
+    SHMHashTable& operator=(const SHMHashTable&)=delete;
+    SHMHashTable(SHMHashTable&&)=delete;
+    SHMHashTable& operator=(SHMHashTable&&)=delete;
+
+    // loads node, returns nullptr when it is not in the table
+    T* select(unsigned moveIdx);
+    template<class... Args>
+    T* store(unsigned moveIdx, Args&&... args);
+    // root needs to be overriden by the best child from the previous search
+    // it should not be called during the search of this process
+    template<class... Args>
+    T* updateRoot(unsigned moveIdx, Args&&... args);
+
+    template<class... Args>
+    T* createRoot(Args&&... args);
+
+    // overwrite base update function
+    void update(unsigned moveIdx, T* node);
+
+    // table of an other search thread of the process following its own search path
+    SHMHashTable* createWorker();
+
+    NodeArena<T>& getArena();
+
+protected:
+    // wrapper around underlying node type with atomic key and reference bit
+    struct SHashNode{
+        SHashNode():
+        impl(),
+        key(0),
+        code(0),
+        visited(false),
+        busy(false){}
+
+        template<class... Args>
+        void reset(ull key, ull code, Args&&... args){
+            // lookups do not match the node until it is overwritten
+            this->key.store(0, std::memory_order_release);
+            this->code = code;
+            impl.reset(std::forward<Args>(args)...);
+            this->key.store(key, std::memory_order_release);
+        }
+
+        T impl;
+        std::atomic<ull> key;
+        // only changed by the process recycling the node
+        ull code;
+        // reference bit of the clock algorithm
+        std::atomic<bool> visited;
+        // set while the node is being recycled
+        std::atomic<bool> busy;
+    };
+
+    // shared state, placed at the beginning of the shared object
+    struct Header{
+        ull magic;
+        // layout of the object, attaching tables should match it
+        unsigned nodeSize;
+        unsigned budget;
+        unsigned hashCodeSize;
+        unsigned moveNum;
+        ull seed;
+        // set when the object is initialized
+        std::atomic<unsigned> ready;
+        // number of tables using the object
+        std::atomic<unsigned> attached;
+        // number of nodes handed out before the first recycling
+        std::atomic<unsigned> used;
+        // clock hand
+        std::atomic<unsigned> hand;
+        std::atomic<unsigned> tombstones;
+        // never recycled
+        std::atomic<unsigned> root;
+    };
+
+    // mapping of the shared object, shared with the worker tables
+    struct Segment{
+        // creates or attaches to the shared object
+        Segment(const std::string& name, unsigned moveNum, unsigned hashCodeSize, unsigned budget);
+        ~Segment();
+
+        Segment(const Segment&)=delete;
+        Segment& operator=(const Segment&)=delete;
+        Segment(Segment&&)=delete;
+        Segment& operator=(Segment&&)=delete;
+
+        const std::string name;
+        size_t size;
+        void* address;
+        Header* header;
+        // maps hash values to entries (node index and key tag)
+        std::atomic<ull>* table;
+        SHashNode* nodes;
+        // view of the slices of the process
+        std::unique_ptr<NodeArena<T>> arena;
+    };
+
+    static constexpr ull MAGIC = 0x4d4354535348544dULL;
+    // entry index flags
+    static constexpr unsigned EMPTY = UINT_MAX;
+    static constexpr unsigned TOMBSTONE = UINT_MAX - 1;
+    static constexpr ull EMPTYENTRY = ~0ULL;
+
+    static inline unsigned entryIdx(ull entry) { return static_cast<unsigned>(entry); }
+    static inline ull toEntry(unsigned nodeIdx, ull key) { return (key & ~0xFFFFFFFFULL) | nodeIdx; }
+
+    SHMHashTable(std::shared_ptr<Segment> segment, unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize);
+    SHMHashTable(SHMHashTable* owner);
+
+    // probes the entries from the code of a node, returns the index of the node or EMPTY
+    inline unsigned find(ull code, ull key);
+    // index of a node of the table
+    inline unsigned indexOf(const T* node) const;
+    // path nodes might be recycled by other processes
+    bool holds(const T* node) const;
+    // node index to recycle
+    unsigned claim();
+    // puts node index to the first free entry from code
+    void publish(ull code, ull key, unsigned idx);
+    // clean up tombstones, only done when no other process uses the table
+    void rebuild();
+
+    void setupExploration();
+
+    std::shared_ptr<Segment> segment;
+    Header& header;
+    std::atomic<ull>* const table;
+    SHashNode* const nodes;
+    const unsigned budget;
+    // node index found by the last lookup or store
+    unsigned idx;
+};
+
+template<typename T>
+SHMHashTable<T>::Segment::Segment(const std::string& name, unsigned moveNum, unsigned hashCodeSize, unsigned budget):
+    name(name)
+{
+    size_t tableOffset = (sizeof(Header) + 63) / 64 * 64;
+    size_t nodeOffset = (tableOffset + sizeof(std::atomic<ull>) * (1ULL << hashCodeSize) + 63) / 64 * 64;
+    size_t arenaOffset = (nodeOffset + sizeof(SHashNode) * budget + 63) / 64 * 64;
+    size = arenaOffset + NodeArena<T>::bytes(budget);
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    bool creator = fd >= 0;
+    if(!creator && errno == EEXIST)
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if(fd < 0)
+        throw std::runtime_error( "SHMHashTable: can not open shared memory object " + name + ": " + std::strerror(errno) );
+
+    if(creator){
+        if(ftruncate(fd, size) < 0){
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error( "SHMHashTable: can not allocate shared memory object " + name + ": " + std::strerror(errno) );
+        }
+    }
+    else{
+        // the creator might not have set the size yet
+        struct stat st;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while(fstat(fd, &st) == 0 && st.st_size == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if(static_cast<size_t>(st.st_size) != size){
+            close(fd);
+            throw std::invalid_argument( "SHMHashTable: shared memory object " + name + " was created with different parameters" );
+        }
+    }
+
+    address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED){
+        if(creator)
+            shm_unlink(name.c_str());
+        throw std::runtime_error( "SHMHashTable: can not map shared memory object " + name + ": " + std::strerror(errno) );
+    }
+    char* base = static_cast<char*>(address);
+    header = reinterpret_cast<Header*>(base);
+    table = reinterpret_cast<std::atomic<ull>*>(base + tableOffset);
+    nodes = reinterpret_cast<SHashNode*>(base + nodeOffset);
+    arena = std::make_unique<NodeArena<T>>(base + arenaOffset, budget);
+
+    if(creator){
+        new (header) Header{MAGIC, sizeof(SHashNode), budget, hashCodeSize, moveNum, std::random_device{}()};
+        header->attached.store(1, std::memory_order_relaxed);
+        header->used.store(0, std::memory_order_relaxed);
+        header->hand.store(0, std::memory_order_relaxed);
+        header->tombstones.store(0, std::memory_order_relaxed);
+        header->root.store(EMPTY, std::memory_order_relaxed);
+        for(ull code = 0; code < (1ULL << hashCodeSize); ++code)
+            new (table + code) std::atomic<ull>(EMPTYENTRY);
+        for(unsigned nodeIdx = 0; nodeIdx < budget; ++nodeIdx){
+            new (nodes + nodeIdx) SHashNode();
+            arena->bind(nodes[nodeIdx].impl);
+        }
+        header->ready.store(1, std::memory_order_release);
+    }
+    else{
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while(header->ready.load(std::memory_order_acquire) != 1){
+            if(std::chrono::steady_clock::now() > deadline){
+                munmap(address, size);
+                throw std::runtime_error( "SHMHashTable: shared memory object " + name + " was not initialized" );
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if(header->magic != MAGIC || header->nodeSize != sizeof(SHashNode) || header->budget != budget
+           || header->hashCodeSize != hashCodeSize || header->moveNum != moveNum){
+            munmap(address, size);
+            throw std::invalid_argument( "SHMHashTable: shared memory object " + name + " was created with different parameters" );
+        }
+        header->attached.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+SHMHashTable<T>::Segment::~Segment()
+{
+    if(header->attached.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        shm_unlink(name.c_str());
+    munmap(address, size);
+}
+
+template<typename T>
+SHMHashTable<T>::SHMHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned budget, std::string name):
+    SHMHashTable(
+        [&]{
+            // checked before the shared object is created
+            if(hashCodeSize >= 32 || (1ULL << hashCodeSize) < 2ULL * budget)
+                throw std::invalid_argument( "SHMHashTable: load factor should not exceed 0.5" );
+            if(budget < maxDepth + 1)
+                throw std::invalid_argument( "SHMHashTable: budget should be greater than " + std::to_string(maxDepth) );
+            return std::make_shared<Segment>(name, moveNum, hashCodeSize, budget);
+        }(),
+        moveNum, maxDepth, hashCodeSize)
+{
+}
+
+template<typename T>
+SHMHashTable<T>::SHMHashTable(std::shared_ptr<Segment> segment, unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize):
+    ZHashTableBase<SHMHashTable<T>>(moveNum, maxDepth, hashCodeSize, segment->header->seed),
+    segment(segment),
+    header(*segment->header),
+    table(segment->table),
+    nodes(segment->nodes),
+    budget(segment->header->budget),
+    idx(EMPTY)
+{
+}
+
+template<typename T>
+SHMHashTable<T>::SHMHashTable(SHMHashTable* owner):
+    ZHashTableBase<SHMHashTable<T>>(owner),
+    segment(owner->segment),
+    header(owner->header),
+    table(owner->table),
+    nodes(owner->nodes),
+    budget(owner->budget),
+    idx(EMPTY)
+{
+}
+
+template<typename T>
+SHMHashTable<T>* SHMHashTable<T>::createWorker()
+{
+    return new SHMHashTable(this);
+}
+
+template<typename T>
+NodeArena<T>& SHMHashTable<T>::getArena()
+{
+    return *segment->arena;
+}
+
+template<typename T>
+inline unsigned SHMHashTable<T>::find(ull code, ull key)
+{
+    // see CRZHashTable::find for the probe limit
+    ull tag = key & ~0xFFFFFFFFULL;
+    ull entry = table[code].load(std::memory_order_acquire);
+    for(ull steps = 0; entryIdx(entry) != EMPTY && steps <= Base::hashCodeMask; ++steps){
+        unsigned nodeIdx = entryIdx(entry);
+        // the full key is verified as the node might have been recycled since the entry was written
+        if(nodeIdx != TOMBSTONE && (entry & ~0xFFFFFFFFULL) == tag
+           && nodes[nodeIdx].key.load(std::memory_order_acquire) == key)
+            return nodeIdx;
+        code = (code + 1) & Base::hashCodeMask;
+        entry = table[code].load(std::memory_order_acquire);
+    }
+    return EMPTY;
+}
+
+template<typename T>
+inline unsigned SHMHashTable<T>::indexOf(const T* node) const
+{
+    return (reinterpret_cast<const char*>(node) - reinterpret_cast<const char*>(std::addressof(nodes[0].impl))) / sizeof(SHashNode);
+}
+
+template<typename T>
+bool SHMHashTable<T>::holds(const T* node) const
+{
+    return nodes[indexOf(node)].key.load(std::memory_order_acquire) == Base::currKey;
+}
+
+template<typename T>
+T* SHMHashTable<T>::select(unsigned moveIdx)
+{
+    idx = find(Base::currCode ^ Base::hashCodes[moveIdx], Base::currKey ^ Base::hashKeys[moveIdx]);
+    // see RZHashTable::select for the case of 2 states mapped to the same entry with the same hashKey
+    return idx == EMPTY ? nullptr : std::addressof(nodes[idx].impl);
+}
+
+template<typename T>
+void SHMHashTable<T>::update(unsigned moveIdx, T* node)
+{
+    // Zobrist hashing
+    Base::update(moveIdx, node);
+    idx = indexOf(node);
+    // give the node a second chance
+    nodes[idx].visited.store(true, std::memory_order_relaxed);
+}
+
+template<typename T>
+unsigned SHMHashTable<T>::claim()
+{
+    // fresh nodes first
+    if(header.used.load(std::memory_order_relaxed) < budget){
+        unsigned nodeIdx = header.used.fetch_add(1, std::memory_order_relaxed);
+        if(nodeIdx < budget){
+            nodes[nodeIdx].busy.store(true, std::memory_order_relaxed);
+            return nodeIdx;
+        }
+    }
+    // clock algorithm, see CRZHashTable::claim
+    while(true){
+        unsigned nodeIdx = header.hand.fetch_add(1, std::memory_order_relaxed) % budget;
+        SHashNode& node = nodes[nodeIdx];
+        if(nodeIdx == header.root.load(std::memory_order_relaxed)
+           || node.visited.exchange(false, std::memory_order_relaxed))
+            continue;
+        bool busy = false;
+        if(!node.busy.compare_exchange_strong(busy, true, std::memory_order_acquire))
+            continue;
+        // remove node from the table, it can not be found by new lookups from now on
+        ull code = node.code;
+        ull entry = table[code].load(std::memory_order_acquire);
+        while(entryIdx(entry) != EMPTY){
+            if(entryIdx(entry) == nodeIdx){
+                if(table[code].compare_exchange_strong(entry, toEntry(TOMBSTONE, 0), std::memory_order_acq_rel)){
+                    header.tombstones.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+                // entry has changed in the meantime, check it again
+                continue;
+            }
+            code = (code + 1) & Base::hashCodeMask;
+            entry = table[code].load(std::memory_order_acquire);
+        }
+        return nodeIdx;
+    }
+}
+
+template<typename T>
+void SHMHashTable<T>::publish(ull code, ull key, unsigned nodeIdx)
+{
+    while(true){
+        ull entry = table[code].load(std::memory_order_acquire);
+        if(entryIdx(entry) == EMPTY || entryIdx(entry) == TOMBSTONE){
+            if(table[code].compare_exchange_strong(entry, toEntry(nodeIdx, key), std::memory_order_acq_rel)){
+                if(entryIdx(entry) == TOMBSTONE)
+                    header.tombstones.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            // claimed by an other table in the meantime, check it again
+            continue;
+        }
+        code = (code + 1) & Base::hashCodeMask;
+    }
+}
+
+template<typename T>
+template<class... Args>
+T* SHMHashTable<T>::store(unsigned moveIdx, Args&&... args)
+{
+    T* node = select(moveIdx);
+    // Zobrist hashing
+    Base::update(moveIdx);
+
+    if(node){
+        nodes[idx].visited.store(true, std::memory_order_relaxed);
+        return Base::track(node);
+    }
+
+    // duplicates stored at the same time are never found again and they are recycled
+    idx = claim();
+    SHashNode& hashNode = nodes[idx];
+    hashNode.reset(Base::currKey, Base::currCode, std::forward<Args>(args)...);
+    hashNode.visited.store(true, std::memory_order_relaxed);
+    publish(Base::currCode, Base::currKey, idx);
+    hashNode.busy.store(false, std::memory_order_release);
+    return Base::track(std::addressof(hashNode.impl));
+}
+
+template<typename T>
+template<class... Args>
+T* SHMHashTable<T>::createRoot(Args&&... args)
+{
+    // the root might have been created by an other process
+    T* root = Base::createRoot(std::forward<Args>(args)...);
+    header.root.store(find(Base::currCode, Base::currKey), std::memory_order_relaxed);
+    return root;
+}
+
+template<typename T>
+template<class... Args>
+T* SHMHashTable<T>::updateRoot(unsigned moveIdx, Args&&... args){
+    // processes are expected to search the same root, the old one is the first to be recycled
+    unsigned oldRoot = header.root.load(std::memory_order_relaxed);
+    if(oldRoot != EMPTY)
+        nodes[oldRoot].visited.store(false, std::memory_order_relaxed);
+    T* root = select(moveIdx);
+    if(!root){
+        root = store(moveIdx, std::forward<Args>(args)...);
+        ++Base::rootDepth;
+    }
+    else
+        // Zobrist hashing
+        Base::updateRoot(moveIdx, root);
+    header.root.store(idx, std::memory_order_relaxed);
+    // tombstones increase the probe lengths, entries can only be rebuilt when no other process is searching
+    if(header.tombstones.load(std::memory_order_relaxed) > budget && header.attached.load(std::memory_order_relaxed) == 1)
+        rebuild();
+    return root;
+}
+
+template<typename T>
+void SHMHashTable<T>::rebuild()
+{
+    for(ull code = 0; code <= Base::hashCodeMask; ++code)
+        table[code].store(EMPTYENTRY, std::memory_order_relaxed);
+    header.tombstones.store(0, std::memory_order_relaxed);
+    unsigned used = std::min<unsigned>(header.used.load(std::memory_order_relaxed), budget);
+    for(unsigned nodeIdx = 0; nodeIdx < used; ++nodeIdx)
+        publish(nodes[nodeIdx].code, nodes[nodeIdx].key.load(std::memory_order_relaxed), nodeIdx);
+}
+
+template<typename T>
+void SHMHashTable<T>::setupExploration(){
+    idx = EMPTY;
+}
+
+#endif // SHMHASHTABLE_H
@@ -0,0 +1,72 @@
+#ifndef TABLESIZE_H
+#define TABLESIZE_H
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+/**********************************************************************************
+ * Sizing of the hashtables                                                       *
+ * - The load factor of a table is the ratio of its node budget and the number of *
+ * nodes its entries can hold. Linear probing tables accept at most 0.5, tables   *
+ * with several nodes per entry are full at 1                                     *
+ * - Requirements on table type T:                                                *
+ *   static constexpr double MAXLOAD: maximum load factor of the table            *
+ *   static size_t nodeCapacity(unsigned hashCodeSize): nodes at load factor 1    *
+ *   static size_t bytes(unsigned hashCodeSize, unsigned budget): memory of the   *
+ *   entries, nodes and their per move arrays                                     *
+ * - Node sizes depend on the game (per move arrays), so the nodes should be set  *
+ * up before the tables are sized                                                 *
+ **********************************************************************************/
+
+struct TableSize
+{
+    unsigned hashCodeSize;
+    unsigned budget;
+};
+
+namespace TableSizeDetail{
+    // hash codes of the moves are distinct so there is at least an entry per move
+    inline unsigned minHashCodeSize(unsigned moveNum){
+        unsigned hashCodeSize = 1;
+        while((1ull << hashCodeSize) < moveNum)
+            ++hashCodeSize;
+        return hashCodeSize;
+    }
+}
+
+// smallest table holding budget nodes with a load factor of at most maxLoad
+template<typename T>
+unsigned fitHashCodeSize(unsigned budget, unsigned moveNum, double maxLoad=0.5)
+{
+    double load = std::min(maxLoad, T::MAXLOAD);
+    unsigned hashCodeSize = TableSizeDetail::minHashCodeSize(moveNum);
+    while(budget > load * T::nodeCapacity(hashCodeSize)){
+        if(++hashCodeSize == 32)
+            throw std::invalid_argument( "TableSize: budget does not fit into 32 bit hash codes" );
+    }
+    return hashCodeSize;
+}
+
+// largest node budget and the smallest table holding it within bytes with a load factor of at most maxLoad
+// budget is 0 when not even the smallest table fits
+template<typename T>
+TableSize fitBytes(size_t bytes, unsigned moveNum, double maxLoad=0.5)
+{
+    double load = std::min(maxLoad, T::MAXLOAD);
+    TableSize best{TableSizeDetail::minHashCodeSize(moveNum), 0};
+    for(unsigned hashCodeSize = best.hashCodeSize; hashCodeSize < 32; ++hashCodeSize){
+        size_t entryBytes = T::bytes(hashCodeSize, 0);
+        // larger tables leave even less memory for the nodes
+        if(entryBytes > bytes)
+            break;
+        size_t nodeBytes = T::bytes(hashCodeSize, 1) - entryBytes;
+        size_t budget = std::min<size_t>({(bytes - entryBytes) / nodeBytes,
+                                          static_cast<size_t>(load * T::nodeCapacity(hashCodeSize)), UINT_MAX});
+        if(budget > best.budget)
+            best = {hashCodeSize, static_cast<unsigned>(budget)};
+    }
+    return best;
+}
+
+#endif // TABLESIZE_H
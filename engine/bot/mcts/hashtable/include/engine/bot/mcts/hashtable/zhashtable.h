@@ -2,6 +2,8 @@
 #define ZHASHTABLE_H
 
 #include "zhashtablebase.h"
+#include "nodearena.h"
+#include "pageallocator.h"
 
 #include <vector>
 #include <array>
@@ -11,9 +13,24 @@
  * Zobrist HashTable implementation with simple replacement scheme                *
  * - Collision is handled by storing new items in arrays at each entry            *
  * - When the # of items to store would exceed 2 the following replacement scheme *
- * is employed:                                                *                  *
+ * is employed:                                                                   *
  * We discard the item that is deeper, if they are at the same depth we keep      *
  * the one that has been visited more                                             *
+ * - Nodes are drawn from a fixed-size pool of budget nodes: bump allocation in a *
+ * contiguous block and a free list of the nodes that are cut off above the root  *
+ * when the root is updated. Replaced nodes stay in the pool through the helper   *
+ * node swap, so the pool is not touched by the replacement scheme                *
+ * - When the pool is used up nodes are only replaced. A new state mapped to an   *
+ * empty entry is expanded into the helper node without storing it                *
+ * - Per move arrays of the nodes (see NodeArena) are reserved with the pool and  *
+ * handed out as nodes are allocated, replaced nodes keep their slices            *
+ * - There is no heap allocation during the search phase and the nodes are not    *
+ * destroyed one by one                                                           *
+ * - Entries, nodes and per move arrays can be mapped on huge pages (see          *
+ * PageAllocator)                                                                 *
+ * - Parents can cache the pool indices of their children (edges). Nodes out of   *
+ * the entries (free or helper nodes) have no key, so a cached node holding the   *
+ * key of the child is the child                                                  *
  **********************************************************************************/
 
 template<typename T>
@@ -22,7 +39,7 @@ class ZHashTable: public ZHashTableBase<ZHashTable<T>>
 public:
     ZHASHTABLEBASE_SETUP(ZHashTable<T>)
 
-    ZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=20);
+    ZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=20, unsigned budget=50000, bool hugePages=false);
     ~ZHashTable();
 
     ZHashTable(const ZHashTable&)=delete;
@@ -48,8 +65,13 @@ protected:
         unsigned depth;
     };
 public:
+    static constexpr bool edges = true;
+
     // loads node, returns nullptr when it is not in the table
     T* select(unsigned moveIdx) const;
+    // loads node from the cached index of the caller (edge) when it still holds the node, probes the table and
+    // updates the edge otherwise
+    T* select(unsigned moveIdx, uint32_t& edge) const;
 
     template<class... Args>
     T* store(unsigned moveIdx, Args&&... args);
@@ -57,31 +79,169 @@ public:
     template<class... Args>
     T* updateRoot(unsigned moveIdx, Args&&... args);
 
+    // table sharing the nodes with this one but following its own search path. Used by additional
+    // search threads, the caller is responsible for synchronizing the access to the shared nodes
+    ZHashTable* createWorker();
+
+    NodeArena<T>& getArena();
+
+    // ---- table sizes (see tablesize.h) ----
+    // maximum ratio of the budget and the node capacity
+    static constexpr double MAXLOAD = 1.0;
+    // number of nodes the entries can hold
+    static size_t nodeCapacity(unsigned hashCodeSize);
+    // memory of a table with budget nodes
+    static size_t bytes(unsigned hashCodeSize, unsigned budget);
+
 protected:
+    ZHashTable(ZHashTable* owner);
+
+    typedef std::vector<std::array<DHashNode*, 2>, PageAllocator<std::array<DHashNode*, 2>>> Slots;
+
+    // entries and the node pool, shared with the worker tables
+    struct Storage{
+        Storage(unsigned hashCodeSize, unsigned budget, bool hugePages);
+        ~Storage();
+
+        Storage(const Storage&)=delete;
+        Storage& operator=(const Storage&)=delete;
+
+        Slots slots;
+        PageAllocator<DHashNode> allocator;
+        // nodes are constructed when they are handed out the first time
+        DHashNode* const nodes;
+        const unsigned budget;
+        // number of constructed nodes
+        unsigned size;
+        std::vector<DHashNode*> freeNodes;
+        NodeArena<T> arena;
+    };
+
+    // new node from the pool, nullptr when it is used up
+    DHashNode* allocate();
+    // node out of the entries, it is not found through the edges anymore
+    static void unlink(DHashNode* node);
+    // returns the nodes above depth to the pool
+    void release(unsigned depth);
+
     void setupExploration();
-    std::vector<std::array<DHashNode*, 2>> table;
+
+    std::shared_ptr<Storage> storage;
+    Slots& table;
     T* rp;
     DHashNode* helperNode;
 };
 
 template<typename T>
-ZHashTable<T>::ZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize):
+ZHashTable<T>::Storage::Storage(unsigned hashCodeSize, unsigned budget, bool hugePages):
+    slots(pow(2, hashCodeSize), std::array<DHashNode*, 2>{nullptr, nullptr}, PageAllocator<std::array<DHashNode*, 2>>(hugePages)),
+    allocator(hugePages),
+    nodes(allocator.allocate(budget)),
+    budget(budget),
+    size(0),
+    arena(hugePages)
+{
+    freeNodes.reserve(budget);
+    arena.reserve(budget);
+}
+
+template<typename T>
+ZHashTable<T>::Storage::~Storage()
+{
+    if constexpr(!std::is_trivially_destructible_v<DHashNode>){
+        for(unsigned i = 0; i < size; ++i)
+            nodes[i].~DHashNode();
+    }
+    allocator.deallocate(nodes, budget);
+}
+
+template<typename T>
+ZHashTable<T>::ZHashTable(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned budget, bool hugePages):
     ZHashTableBase<ZHashTable<T>>(moveNum, maxDepth, hashCodeSize),
-    table{std::vector<std::array<DHashNode*, 2>>(pow(2, hashCodeSize), {nullptr, nullptr})},
+    storage(std::make_shared<Storage>(hashCodeSize, budget, hugePages)),
+    table(storage->slots),
+    rp(nullptr),
+    helperNode(allocate())
+{
+    // a node for the root and for the helper of the table
+    if(budget < 2)
+        throw std::invalid_argument( "ZHashTable: budget should be greater than 1" );
+}
+
+template<typename T>
+ZHashTable<T>::ZHashTable(ZHashTable* owner):
+    ZHashTableBase<ZHashTable<T>>(owner),
+    storage(owner->storage),
+    table(storage->slots),
     rp(nullptr),
-    helperNode(new DHashNode())
-{}
+    helperNode(allocate())
+{
+    if(!helperNode)
+        throw std::invalid_argument( "ZHashTable: budget is used up by the worker tables" );
+}
+
+template<typename T>
+ZHashTable<T>* ZHashTable<T>::createWorker()
+{
+    return new ZHashTable(this);
+}
+
+template<typename T>
+NodeArena<T>& ZHashTable<T>::getArena()
+{
+    return storage->arena;
+}
+
+template<typename T>
+size_t ZHashTable<T>::nodeCapacity(unsigned hashCodeSize)
+{
+    return 2 * (size_t(1) << hashCodeSize);
+}
+
+template<typename T>
+size_t ZHashTable<T>::bytes(unsigned hashCodeSize, unsigned budget)
+{
+    // entries, nodes and their free list
+    return (size_t(1) << hashCodeSize) * sizeof(std::array<DHashNode*, 2>) + budget * (sizeof(DHashNode) + sizeof(DHashNode*)) +
+           NodeArena<T>::bytes(budget);
+}
 
 template<typename T>
 ZHashTable<T>::~ZHashTable()
 {
-    if(rp)
-        delete rp;
-    delete helperNode;
+    // nodes are destroyed with the pool
+    if(Base::owner){
+        unlink(helperNode);
+        storage->freeNodes.push_back(helperNode);
+    }
+}
+
+template<typename T>
+typename ZHashTable<T>::DHashNode* ZHashTable<T>::allocate()
+{
+    if(!storage->freeNodes.empty()){
+        DHashNode* node = storage->freeNodes.back();
+        storage->freeNodes.pop_back();
+        return node;
+    }
+    if(storage->size == storage->budget)
+        return nullptr;
+    DHashNode* node = new(storage->nodes + storage->size++) DHashNode();
+    storage->arena.bind(node->impl.impl);
+    return node;
+}
+
+template<typename T>
+void ZHashTable<T>::release(unsigned depth)
+{
+    // nodes above the root can not be reached from the root anymore
     for(auto& slot : table){
-        for(auto p : slot){
-            if(p)
-                delete p;
+        for(auto& p : slot){
+            if(p && p->depth < depth){
+                unlink(p);
+                storage->freeNodes.push_back(p);
+                p = nullptr;
+            }
         }
     }
 }
@@ -111,61 +271,74 @@ T* ZHashTable<T>::select(unsigned moveIdx) const
     return rp; // nullptr during selection, removed node during backpropagation
 }
 
+template<typename T>
+T* ZHashTable<T>::select(unsigned moveIdx, uint32_t& edge) const
+{
+    ull key = Base::currKey ^ Base::hashKeys[moveIdx];
+    if(storage->nodes[edge].impl.key == key)
+        return std::addressof(storage->nodes[edge].impl.impl);
+    for(auto p : table[Base::currCode ^ Base::hashCodes[moveIdx]]){
+        // see select above
+        if(p && p->impl.key == key){
+            edge = p - storage->nodes;
+            return std::addressof(p->impl.impl);
+        }
+    }
+    return nullptr;
+}
+
+template<typename T>
+void ZHashTable<T>::unlink(DHashNode* node)
+{
+    // keys of the states are random 64 bit numbers, 0 is taken as no state like in the empty pool
+    node->impl.key = 0;
+}
+
 template<typename T>
 template<class... Args>
 T* ZHashTable<T>::store(unsigned moveIdx, Args&&... args)
 {
     // zobrist hashing
     Base::update(moveIdx);
-    // replacement scheme
-    // node deallocation is postponed after backpropagation
-    // because node might be removed from the selection path
+    auto& slot = table[Base::currCode];
+    DHashNode* node = !slot[0] || !slot[1] ? allocate() : nullptr;
     T* res;
-    if(!table[Base::currCode][0]){
-        table[Base::currCode][0] = new DHashNode(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
-        res = std::addressof(table[Base::currCode][0]->impl.impl);
+    if(node){
+        node->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
+        slot[slot[0] ? 1 : 0] = node;
+        res = std::addressof(node->impl.impl);
     }
-    else if(!table[Base::currCode][1]){
-        table[Base::currCode][1] = new DHashNode(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
-        res = std::addressof(table[Base::currCode][1]->impl.impl);
+    else if(!slot[0] && !slot[1]){
+        // pool is used up, the leaf is only kept for the current search cycle
+        helperNode->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
+        res = std::addressof(helperNode->impl.impl);
     }
     else{
+        // replacement scheme
+        // node deallocation is postponed after backpropagation
+        // because node might be removed from the selection path
         // reachable ? -> closer to root ? -> visit count ?
+        // the root is at rootDepth, only the nodes above it are unreachable
+        unsigned idx;
+        if(!slot[0] || !slot[1])
+            idx = slot[0] ? 0 : 1;
+        else if(slot[0]->depth < Base::rootDepth)
+            idx = 0;
+        else if(slot[1]->depth < Base::rootDepth)
+            idx = 1;
+        else if(slot[0]->depth != slot[1]->depth)
+            idx = slot[0]->depth > slot[1]->depth ? 0 : 1;
+        else
+            idx = slot[0]->impl.impl.getVisitCount() < slot[1]->impl.impl.getVisitCount() ? 0 : 1;
         // we overwrite replaced node after backpropagation
-        if(table[Base::currCode][0]->depth <= Base::rootDepth){
-            std::swap(table[Base::currCode][0], helperNode);
-            table[Base::currCode][0]->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
-            res = std::addressof(table[Base::currCode][0]->impl.impl);
-        }
-        else if(table[Base::currCode][1]->depth <= Base::rootDepth){
-            std::swap(table[Base::currCode][1], helperNode);
-            table[Base::currCode][1]->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
-            res = std::addressof(table[Base::currCode][1]->impl.impl);
-        }
-        else if(table[Base::currCode][0]->depth > table[Base::currCode][1]->depth){
-            std::swap(table[Base::currCode][0], helperNode);
-            table[Base::currCode][0]->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
-            res = std::addressof(table[Base::currCode][0]->impl.impl);
-        }
-        else if(table[Base::currCode][0]->depth < table[Base::currCode][1]->depth){
-            std::swap(table[Base::currCode][1], helperNode);
-            table[Base::currCode][1]->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
-            res = std::addressof(table[Base::currCode][1]->impl.impl);
-        }
-        else if(table[Base::currCode][0]->impl.impl.getVisitCount() < table[Base::currCode][1]->impl.impl.getVisitCount()){
-            std::swap(table[Base::currCode][0], helperNode);
-            table[Base::currCode][0]->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
-            res = std::addressof(table[Base::currCode][0]->impl.impl);
-        }
-        else{
-            std::swap(table[Base::currCode][1], helperNode);
-            table[Base::currCode][1]->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
-            res = std::addressof(table[Base::currCode][1]->impl.impl);
-        }
+        std::swap(slot[idx], helperNode);
+        unlink(helperNode);
+        slot[idx]->reset(Base::currKey, Base::currCode, Base::depth, std::forward<Args>(args)...);
+        res = std::addressof(slot[idx]->impl.impl);
     }
     // if deleted node is one of the parents we can still do backpropagation
     rp = std::addressof(helperNode->impl.impl);
-    return res;
+    return Base::track(res);
 }
 
 template<typename T>
@@ -173,11 +346,16 @@ template<class... Args>
 T* ZHashTable<T>::updateRoot(unsigned moveIdx, Args&&... args){
     auto root = select(moveIdx);
     if(!root){
-        root = store(moveIdx, std::forward<Args>(args)...);
         ++Base::rootDepth;
+        // the new root should not be left out of the table when the pool is used up, the nodes of the
+        // previous search are discarded in that case
+        release(storage->freeNodes.empty() && storage->size == storage->budget ? ~0u : Base::rootDepth);
+        root = store(moveIdx, std::forward<Args>(args)...);
+    }
+    else{
+        Base::updateRoot(moveIdx, root);
+        release(Base::rootDepth);
     }
-    else
-        Base::updateRoot(moveIdx);
     rp = nullptr;
     return root;
 }
@@ -185,6 +363,8 @@ T* ZHashTable<T>::updateRoot(unsigned moveIdx, Args&&... args){
 template<typename T>
 void ZHashTable<T>::setupExploration(){
     rp = nullptr;
+    // the helper might hold a leaf that was not stored
+    unlink(helperNode);
 }
 
 #endif // ZHASHTABLE_H
@@ -2,6 +2,9 @@
 #define ZHASHTABLEBASE_H
 
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 #include <random>
 #include <math.h>
 
@@ -12,6 +15,10 @@
  * - default constructor for creating root node                                   *
  * - storing a pointer to a parent node                                           *
  * - reset function to override node                                              *
+ *                                                                                *
+ * The nodes of the search path are recorded on a stack by update and store, so   *
+ * the backpropagation walks the stack instead of probing the table for each      *
+ * parent                                                                         *
  **********************************************************************************/
 
 // type_trait to get node type
@@ -34,6 +41,10 @@ class ZHashTableBase
     friend T;
 private:
     ZHashTableBase(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize=20);
+    // tables created with the same seed use the same hash codes and keys (like tables of different processes)
+    ZHashTableBase(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned long long seed);
+    // worker table starting from the current search path of its owner
+    ZHashTableBase(const ZHashTableBase* owner);
 protected:
     typedef unsigned long long ull;
     ~ZHashTableBase()=default;
@@ -62,45 +73,74 @@ protected:
         ull code;
     };
 public:
+    // tables storing the nodes in the probed entries load the entries of the children into the cache
+    // before the children are scored, it is a no-op for the others
+    static constexpr bool prefetching = false;
+    void prefetch(unsigned) const {}
+    // tables keeping their nodes at stable 32 bit indices serve the children from the indices cached by their
+    // parents (edges) with T* select(unsigned moveIdx, uint32_t& edge). A cached index is valid while the node
+    // at the index holds the key of the child, edges start at 0 which is the index of a node of any state
+    static constexpr bool edges = false;
+
     // do not call this function on leaf node, use expand instead!
-    void update(unsigned moveIdx);
+    // node is the selected child returned by select
+    void update(unsigned moveIdx, typename nodeType<T>::value_type* node);
+    // parent of the current node from the search path, nullptr at the root and when the parent was recycled
     typename nodeType<T>::value_type* backward();
-    void updateRoot(unsigned moveIdx);
+    // reset the search path of a worker table to the root of its owner
+    void selectRoot();
 
     template<class... Args>
     typename nodeType<T>::value_type* createRoot(Args&&... args);
 
 protected:
+    void update(unsigned moveIdx);
+    void updateRoot(unsigned moveIdx, typename nodeType<T>::value_type* root);
+    // records node as the node of the current state on the search path
+    typename nodeType<T>::value_type* track(typename nodeType<T>::value_type* node);
+    // tables whose path nodes might be recycled by other threads check that node still holds the current state
+    bool holds(const typename nodeType<T>::value_type*) const { return true; }
+
     // hashcode to map table entries
-    inline static std::vector<ull> hashCodes;
+    std::vector<ull> hashCodes;
     // unique node identifiers
-    inline static std::vector<ull> hashKeys;
+    std::vector<ull> hashKeys;
     // the hashcode of the current gamestate (node)
     ull currCode;
     // the hashkey of the current gamestate (node)
     ull currKey;
     // currently selected hashkeys stored for backpropagation
     unsigned depth;
-    inline static unsigned rootDepth;
+    unsigned rootDepth;
+    // table sharing its nodes with the worker tables of the search threads, nullptr for the owner itself
+    const ZHashTableBase* const owner;
 private:
-    inline static ull hashCodeMask;
+    ull hashCodeMask;
     std::vector<ull> moveIdxs;
+    // nodes of the search path indexed by depth, the root is at rootDepth
+    std::vector<typename nodeType<T>::value_type*> path;
 };
 
 template<typename T>
 ZHashTableBase<T>::ZHashTableBase(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize):
+    ZHashTableBase(moveNum, maxDepth, hashCodeSize, std::random_device{}())
+{
+}
+
+template<typename T>
+ZHashTableBase<T>::ZHashTableBase(unsigned moveNum, unsigned maxDepth, unsigned hashCodeSize, unsigned long long seed):
     currCode(0),
     currKey(0),
-    depth(0)
+    depth(0),
+    rootDepth(0),
+    owner(nullptr)
 {
-    rootDepth = 0;
     // this is unlikely but we check it for completeness
     if(moveNum > pow(2, hashCodeSize))
         throw std::invalid_argument( "RZHashTable: number of possible moves is greater than the number of entries" );
     // pick moveNum hashCodes randomly without repetition
     // normally you would use sample or random_shuffle but not for 64 bit
-    std::random_device rd;
-    std::mt19937_64 eng(rd());
+    std::mt19937_64 eng(seed);
     std::uniform_int_distribution<ull> distr;
     // since the number of entries is multiplies of 2 we can unset the most signifficant bits
     // this way indices map to the table correctly and we do not need to apply the
@@ -121,6 +161,36 @@ ZHashTableBase<T>::ZHashTableBase(unsigned moveNum, unsigned maxDepth, unsigned
         hashKeys.push_back(n);
     }
     moveIdxs = std::vector<ull>(maxDepth + 1, 0);
+    path = std::vector<typename nodeType<T>::value_type*>(maxDepth + 2, nullptr);
+}
+
+template<typename T>
+ZHashTableBase<T>::ZHashTableBase(const ZHashTableBase* owner):
+    hashCodes(owner->hashCodes),
+    hashKeys(owner->hashKeys),
+    currCode(owner->currCode),
+    currKey(owner->currKey),
+    depth(owner->depth),
+    rootDepth(owner->rootDepth),
+    owner(owner),
+    hashCodeMask(owner->hashCodeMask),
+    moveIdxs(owner->moveIdxs),
+    path(owner->path)
+{
+}
+
+template<typename T>
+void ZHashTableBase<T>::selectRoot()
+{
+    if(!owner)
+        return;
+    // search path of the owner is always at the root as it is not used for selection
+    currCode = owner->currCode;
+    currKey = owner->currKey;
+    depth = owner->depth;
+    rootDepth = owner->rootDepth;
+    path[rootDepth] = owner->path[rootDepth];
+    static_cast<T&>(*this).setupExploration();
 }
 
 template<typename T>
@@ -134,10 +204,24 @@ void ZHashTableBase<T>::update(unsigned moveIdx)
 }
 
 template<typename T>
-void ZHashTableBase<T>::updateRoot(unsigned moveIdx)
+void ZHashTableBase<T>::update(unsigned moveIdx, typename nodeType<T>::value_type* node)
 {
-    ++rootDepth;
     update(moveIdx);
+    path[depth] = node;
+}
+
+template<typename T>
+void ZHashTableBase<T>::updateRoot(unsigned moveIdx, typename nodeType<T>::value_type* root)
+{
+    ++rootDepth;
+    update(moveIdx, root);
+}
+
+template<typename T>
+typename nodeType<T>::value_type* ZHashTableBase<T>::track(typename nodeType<T>::value_type* node)
+{
+    path[depth] = node;
+    return node;
 }
 
 template<typename T>
@@ -145,10 +229,10 @@ typename nodeType<T>::value_type* ZHashTableBase<T>::backward()
 {
     if(rootDepth < depth){
         --depth;
-        auto parent = static_cast<T&>(*this).select(moveIdxs[depth]);
         currCode ^= hashCodes[moveIdxs[depth]];
         currKey ^= hashKeys[moveIdxs[depth]];
-        return parent;
+        auto parent = path[depth];
+        return static_cast<const T&>(*this).holds(parent) ? parent : nullptr;
     }
     else{
         // if constexpr(std::is_same_v<ZHashTable<nodeType<T>::value_type>, T>)
@@ -164,6 +248,7 @@ typename nodeType<T>::value_type* ZHashTableBase<T>::createRoot(Args&&... args)
     currKey ^= hashKeys[0];
     auto root = static_cast<T&>(*this).store(0, std::forward<Args>(args)...);
     --depth;
+    track(root);
     static_cast<T&>(*this).setupExploration();
     return root;
 }
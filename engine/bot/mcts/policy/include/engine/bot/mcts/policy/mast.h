@@ -1,6 +1,7 @@
 #ifndef MAST_H
 #define MAST_H
 
+#include <algorithm>
 #include <vector>
 #include <array>
 #include <tuple>
@@ -35,6 +36,9 @@ protected:
     G& game;
     // we only need to update moves that are taken after the current root
     int from;
+    // preallocate space for the cumulative weights of the legal moves so sampling does not allocate
+    std::vector<double> probs;
+    std::mt19937 generator;
 };
 
 template<typename G>
@@ -42,7 +46,9 @@ MAST<G>::MAST(G& game, double temp, double w):
     game(game),
     temp(temp),
     w(w),
-    from(0)
+    from(0),
+    probs(game.getMaxValidMoveNum()),
+    generator(std::random_device{}())
 {
     std::array<std::vector<double>, G::PIECENUM> pieceScores; 
     pieceScores.fill(std::vector<double>(game.getMaxValidMoveNum(), 0.5));
@@ -59,19 +65,20 @@ void MAST<G>::updateRoot()
 
 template<typename G>
 std::tuple<unsigned, unsigned> MAST<G>::select() {
-    std::random_device rd;
-    std::mt19937 generator(rd());
     unsigned depth = game.getCurrentDepth();
-    std::vector<double> probs;
-    probs.reserve(game.getValidMoves().size());
+    unsigned size = 0;
+    double total = 0;
     for(const auto& move : game.getValidMoves()){
         auto piece = move.getPiece();
         auto pos = move.getPos();
         // no normalization is needed, relative volume matters
-        probs.push_back(exp(scores[depth][game.getNextPlayer()][piece][pos]/temp));
+        total += exp(scores[depth][game.getNextPlayer()][piece][pos]/temp);
+        probs[size++] = total;
     }
-    std::discrete_distribution<> distribution (probs.begin(), probs.end());
-    unsigned idx = distribution(generator);
+    // inverse transform sampling on the cumulative weights (std::discrete_distribution allocates)
+    double sample = std::uniform_real_distribution<double>(0, total)(generator);
+    unsigned idx = std::upper_bound(probs.begin(), probs.begin() + size, sample) - probs.begin();
+    idx = std::min(idx, size - 1);
     auto it = game.getValidMoves().begin();
     std::advance(it, idx);
 
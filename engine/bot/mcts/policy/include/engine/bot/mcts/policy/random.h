@@ -21,28 +21,22 @@ public:
 
 protected:
     G& game;
-    // preallocate space for random sampling upfront by using the number of maximum legal moves
-    std::vector<unsigned> probs;
+    // seeded once, the distributions below do not allocate
+    std::mt19937 generator;
 };
 
 template<typename G>
 RandomPolicy<G>::RandomPolicy(G& game):
     game(game),
-    probs(game.getMaxValidMoveNum(), 1)
+    generator(std::random_device{}())
 {
 }
 
 template<typename G>
 std::tuple<unsigned, unsigned> RandomPolicy<G>::select() {
-    std::random_device rd;
-    std::mt19937 generator(rd());
     const auto& moves = game.getValidMoves();
-    unsigned idx = moves.size();
-
-    auto it = probs.begin();
-    std::advance(it, idx); // only pick from legal moves
-    std::discrete_distribution<unsigned> distribution (probs.begin(), it);
-    idx = distribution(generator);
+    // only pick from legal moves
+    unsigned idx = std::uniform_int_distribution<unsigned>(0, moves.size() - 1)(generator);
     auto itSelected = game.getValidMoves().begin();
     std::advance(itSelected, idx);
 
@@ -4,19 +4,8 @@
 #include <math.h>
 #include <chrono>
 
-// type_trait to get node type
-template<typename T>
-struct extractNodeType //lets call it extract_value_type
-{
-    typedef T value_type;
-};
-
-template<template<typename> class T, typename N>
-struct extractNodeType<T<N>>   //specialization
-{
-    typedef N value_type;
-};
-
+// T is a hashtable or any other type providing select for the children statistics of the root
+// (like the merged statistics of root parallel search)
 template<typename G, typename T>
 class StopScheduler{
 public:
@@ -129,9 +118,9 @@ bool StopScheduler<G, T>::finish(){
     double secondMaxScore = -1;
     double score;
 
-    typename extractNodeType<T>::value_type* bestNode;
-    typename extractNodeType<T>::value_type* secondBestNode;
-    
+    decltype(table.select(0)) bestNode = nullptr;
+    decltype(table.select(0)) secondBestNode = nullptr;
+
     for(const auto& move : game.getValidMoves()){
         unsigned moveIdx = game.toMoveIdx(move.getPiece(), move.getPos());
         auto node = table.select(moveIdx);
@@ -0,0 +1,93 @@
+#ifndef SEARCHSERVER_H
+#define SEARCHSERVER_H
+
+#include "threadpool.h"
+#include "engine/bot/mcts/base/mctsbot.h"
+#include "engine/game/omega/omega.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**********************************************************************************
+ * Headless search service hosting many Omega games                               *
+ * - Each game has its own single threaded MCTS engine. Searches are split into   *
+ * batches of search cycles that are run on a shared work-stealing thread pool,   *
+ * so the cores are not oversubscribed however many games are searched           *
+ * - A game has at most one batch in the pool at a time and its next batch is     *
+ * queued behind the batches of the other games, this way the active games are    *
+ * served in turn                                                                 *
+ * - Searches are stopped by the StopScheduler of the engines, time spent waiting  *
+ * in the pool counts towards the deadline                                        *
+ * - Functions of the service can be called from any thread. Per-game calls wait  *
+ * for at most one batch of the game                                              *
+ **********************************************************************************/
+
+class SearchServer
+{
+public:
+    // batchSize: number of search cycles run at once for a game
+    SearchServer(unsigned threadNum, unsigned batchSize=32);
+    ~SearchServer();
+
+    SearchServer(const SearchServer&)=delete;
+    SearchServer& operator=(const SearchServer&)=delete;
+    SearchServer(SearchServer&&)=delete;
+    SearchServer& operator=(SearchServer&&)=delete;
+
+    // creates a new game with its engine (see MCTSBot for the parameters), returns the id of the game
+    unsigned open(unsigned boardSize, std::string node, std::string policy, bool recycling, unsigned budget);
+    // cancels the search of the game and removes it
+    void close(unsigned gameId);
+
+    // updates the game by a move of the opponent of the engine
+    void play(unsigned gameId, unsigned moveIdx);
+    // starts a search for the next player, timeLeft is the remaining time on its clock
+    void submit(unsigned gameId, std::chrono::milliseconds timeLeft);
+    // moves of the engine once its search is finished (the game is already updated by them)
+    std::optional<std::vector<unsigned>> poll(unsigned gameId);
+    // stops the search of the game without updating it
+    void cancel(unsigned gameId);
+
+    unsigned getGameNum();
+
+protected:
+    struct Session{
+        Session(unsigned boardSize, std::string node, std::string policy, bool recycling, unsigned budget);
+
+        enum class State{ IDLE, SEARCHING, DONE, FAILED };
+
+        Omega game;
+        MCTSBot bot;
+        // guards the game, the engine and the fields below, batches hold it while they are running
+        std::mutex mutex;
+        State state;
+        // moves found by the last search
+        std::vector<unsigned> moves;
+        std::string error;
+        // identifies the search the batches belong to, increased when a search is started or cancelled
+        unsigned long long search;
+    };
+
+    std::shared_ptr<Session> getSession(unsigned gameId);
+    // runs the next batch of a search and resubmits it until the search is finished
+    void runBatch(std::shared_ptr<Session> session, unsigned long long search);
+    // updates the game by the best moves found, expects the session to be locked
+    void finishSearch(Session& session);
+
+    const unsigned batchSize;
+
+    // guards the sessions
+    std::mutex mutex;
+    std::unordered_map<unsigned, std::shared_ptr<Session>> sessions;
+    unsigned nextId;
+
+    // declared last so the workers are joined before the sessions are destroyed
+    ThreadPool pool;
+};
+
+#endif // SEARCHSERVER_H
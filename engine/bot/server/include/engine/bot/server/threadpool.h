@@ -0,0 +1,65 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**********************************************************************************
+ * Work-stealing thread pool                                                      *
+ * - Each worker has its own task queue. Tasks submitted from a worker go to its  *
+ * own queue, others are distributed round-robin                                  *
+ * - Workers take tasks from the front of their own queue (FIFO so the resubmitted *
+ * tasks of different sources are served in turn) and steal from the back of the  *
+ * other queues when their own is empty                                          *
+ * - Pending tasks are discarded when the pool is destroyed                       *
+ **********************************************************************************/
+
+class ThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    ThreadPool(unsigned threadNum);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)=delete;
+    ThreadPool& operator=(const ThreadPool&)=delete;
+    ThreadPool(ThreadPool&&)=delete;
+    ThreadPool& operator=(ThreadPool&&)=delete;
+
+    void submit(Task task);
+
+    unsigned getThreadNum() const;
+
+protected:
+    struct Queue{
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void work(unsigned idx);
+    // task from the front of the worker's own queue
+    bool pop(unsigned idx, Task& task);
+    // task from the back of an other queue
+    bool steal(unsigned idx, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    // queue of the next task submitted from outside of the pool
+    std::atomic<unsigned> next;
+    // number of tasks in the queues
+    std::atomic<unsigned> queued;
+
+    // idle workers wait for new tasks
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool quit;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,165 @@
+#include "searchserver.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+SearchServer::Session::Session(unsigned boardSize, std::string node, std::string policy, bool recycling, unsigned budget):
+    game(boardSize),
+    bot(game, node, policy, recycling, budget),
+    state(State::IDLE),
+    search(0)
+{
+}
+
+SearchServer::SearchServer(unsigned threadNum, unsigned batchSize):
+    batchSize(batchSize),
+    nextId(0),
+    pool(threadNum)
+{
+    if(batchSize == 0)
+        throw std::invalid_argument( "SearchServer: batch size should be greater than 0" );
+}
+
+SearchServer::~SearchServer()
+{
+    // remaining batches return right away
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& [_, session] : sessions){
+        std::lock_guard<std::mutex> sessionLock(session->mutex);
+        ++session->search;
+    }
+}
+
+unsigned SearchServer::open(unsigned boardSize, std::string node, std::string policy, bool recycling, unsigned budget)
+{
+    auto session = std::make_shared<Session>(boardSize, node, policy, recycling, budget);
+    std::lock_guard<std::mutex> lock(mutex);
+    sessions[nextId] = session;
+    return nextId++;
+}
+
+void SearchServer::close(unsigned gameId)
+{
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = sessions.find(gameId);
+        if(it == sessions.end())
+            throw std::invalid_argument( "SearchServer: invalid game id: " + std::to_string(gameId) );
+        session = it->second;
+        sessions.erase(it);
+    }
+    // a batch in the pool keeps the session alive until it returns
+    std::lock_guard<std::mutex> lock(session->mutex);
+    ++session->search;
+}
+
+std::shared_ptr<SearchServer::Session> SearchServer::getSession(unsigned gameId)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(gameId);
+    if(it == sessions.end())
+        throw std::invalid_argument( "SearchServer: invalid game id: " + std::to_string(gameId) );
+    return it->second;
+}
+
+unsigned SearchServer::getGameNum()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sessions.size();
+}
+
+void SearchServer::play(unsigned gameId, unsigned moveIdx)
+{
+    auto session = getSession(gameId);
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if(session->state == Session::State::SEARCHING)
+        throw std::invalid_argument( "SearchServer: game " + std::to_string(gameId) + " is being searched" );
+    if(session->game.end())
+        throw std::invalid_argument( "SearchServer: game " + std::to_string(gameId) + " has ended" );
+    session->game.update(moveIdx);
+    session->bot.updateByOpponent(moveIdx);
+}
+
+void SearchServer::submit(unsigned gameId, std::chrono::milliseconds timeLeft)
+{
+    auto session = getSession(gameId);
+    unsigned long long search;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if(session->state == Session::State::SEARCHING)
+            throw std::invalid_argument( "SearchServer: game " + std::to_string(gameId) + " is being searched" );
+        if(session->game.end())
+            throw std::invalid_argument( "SearchServer: game " + std::to_string(gameId) + " has ended" );
+        session->moves.clear();
+        session->error.clear();
+        search = ++session->search;
+        session->bot.setTimeLeft(timeLeft);
+        if(session->bot.startSearch()){
+            finishSearch(*session);
+            return;
+        }
+        session->state = Session::State::SEARCHING;
+    }
+    pool.submit([this, session, search]{ runBatch(session, search); });
+}
+
+std::optional<std::vector<unsigned>> SearchServer::poll(unsigned gameId)
+{
+    auto session = getSession(gameId);
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if(session->state == Session::State::FAILED){
+        session->state = Session::State::IDLE;
+        throw std::runtime_error(session->error);
+    }
+    if(session->state != Session::State::DONE)
+        return std::nullopt;
+    session->state = Session::State::IDLE;
+    return session->moves;
+}
+
+void SearchServer::cancel(unsigned gameId)
+{
+    auto session = getSession(gameId);
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if(session->state != Session::State::SEARCHING)
+        return;
+    // the game stays at its root, the statistics collected so far are kept for the next search
+    ++session->search;
+    session->state = Session::State::IDLE;
+}
+
+void SearchServer::runBatch(std::shared_ptr<Session> session, unsigned long long search)
+{
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        // search was cancelled or the game was closed
+        if(session->search != search)
+            return;
+        try{
+            if(!session->bot.searchStep(batchSize)){
+                pool.submit([this, session, search]{ runBatch(session, search); });
+                return;
+            }
+            finishSearch(*session);
+        }
+        catch(const std::exception& e){
+            session->error = e.what();
+            session->state = Session::State::FAILED;
+        }
+    }
+}
+
+void SearchServer::finishSearch(Session& session)
+{
+    unsigned fromDepth = session.game.getCurrentDepth();
+    session.bot.finishSearch();
+    // collect the moves played by the engine
+    auto moves = session.game.getTakenMoves().rbegin();
+    for(unsigned depth = session.game.getCurrentDepth(); depth > fromDepth; --depth){
+        session.moves.push_back(session.game.toMoveIdx(moves.getPiece(), moves.getPos()));
+        --moves;
+    }
+    std::reverse(session.moves.begin(), session.moves.end());
+    session.state = Session::State::DONE;
+}
@@ -0,0 +1,99 @@
+#include "threadpool.h"
+
+#include <stdexcept>
+
+namespace{
+    // pool and queue index of the worker running on the current thread
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local unsigned currentIdx = 0;
+}
+
+ThreadPool::ThreadPool(unsigned threadNum):
+    next(0),
+    queued(0),
+    quit(false)
+{
+    if(threadNum == 0)
+        throw std::invalid_argument( "ThreadPool: number of threads should be greater than 0" );
+    queues.reserve(threadNum);
+    for(unsigned idx = 0; idx < threadNum; ++idx)
+        queues.push_back(std::make_unique<Queue>());
+    threads.reserve(threadNum);
+    for(unsigned idx = 0; idx < threadNum; ++idx)
+        threads.emplace_back(&ThreadPool::work, this, idx);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    cv.notify_all();
+    for(auto& thread : threads)
+        thread.join();
+}
+
+unsigned ThreadPool::getThreadNum() const
+{
+    return threads.size();
+}
+
+void ThreadPool::submit(Task task)
+{
+    unsigned idx = currentPool == this ? currentIdx : next.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        // counted before it is pushed so the counter can not underflow when the task is taken right away
+        // the mutex prevents the lost wake-up of a worker that is about to wait
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[idx]->mutex);
+        queues[idx]->tasks.push_back(std::move(task));
+    }
+    cv.notify_one();
+}
+
+bool ThreadPool::pop(unsigned idx, Task& task)
+{
+    std::lock_guard<std::mutex> lock(queues[idx]->mutex);
+    if(queues[idx]->tasks.empty())
+        return false;
+    task = std::move(queues[idx]->tasks.front());
+    queues[idx]->tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(unsigned idx, Task& task)
+{
+    for(unsigned i = 1; i < queues.size(); ++i){
+        Queue& queue = *queues[(idx + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty()){
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(unsigned idx)
+{
+    currentPool = this;
+    currentIdx = idx;
+    Task task;
+    while(true){
+        if(pop(idx, task) || steal(idx, task)){
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]{ return quit || queued.load(std::memory_order_relaxed) > 0; });
+        if(quit)
+            return;
+    }
+}
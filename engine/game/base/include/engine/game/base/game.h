@@ -1,15 +1,17 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <memory>
+
 /***********************************************************************************
  * Base class for games providing a shared root state that can be used to          *
- * periodically update the derived instance during MCTS search                     *             *
+ * periodically update the derived instance during MCTS search                     *
  * Plus it provides some functionalities that are universal for 2 player board     *
  * games.                                                                          *
- * Derive from Game< *your own game class* > and forward the constructor arguments *
- * to its constructor.                                                             *
- * Make sure to delete all the instances to create a new shared state:             *
- * game = make_shared<Omega>(boardSize); could not change the shared state         *
+ * Derive from Game< *your own game class* >, create the root instance in the      *
+ * public constructor and share it with the copies of the game (like the ones of   *
+ * the search threads). Games created independently do not share any state so     *
+ * several games can be played in the same process                                 *
  ***********************************************************************************/
 
 template<typename G>
@@ -18,8 +20,8 @@ class Game
     // this ensures G to be derived from Game and prevents wrong usage that could cause undefined behavior (static cast in update function)
     friend G;
 
-    template<typename... Args>
-    Game(Args&&... args);
+    // root: shared root state, nullptr for the root instance itself
+    Game(std::shared_ptr<G> root);
 
 public:
     // set derived instance to root state
@@ -39,46 +41,22 @@ public:
     Game& operator=(const Game& game)=delete;
     Game& operator=(Game&& game)=delete;
 
-    ~Game();
+    ~Game()=default;
 
 protected:
     // instance holding the root game state for the derived instance
-    inline static G* root = nullptr;
+    std::shared_ptr<G> root;
 
     unsigned depth;
     unsigned nextPlayer;
-private:
-    inline static unsigned counter = 0;
 };
 
 template<typename G>
-Game<G>::~Game()
-{
-    --counter;
-    // shared state is only deleted when there is no instance left to prevent undefined behaviour
-    // game = make_shared<Omega>(boardSize); would cause this
-    if(root && counter == 0)
-    {
-        G* temp = root; // prevents double free
-        root = nullptr;
-        ++counter;
-        delete temp;
-    }
-}
-
-template<typename G>
-template<typename... Args>
-Game<G>::Game(Args&&... args):
+Game<G>::Game(std::shared_ptr<G> root):
+    root(std::move(root)),
     depth(0),
     nextPlayer(0)
 {
-    ++counter;
-    if(!root)
-    {
-        root = static_cast<G*>(this); // prevents infinite recursion
-        --counter;
-        root = new G(std::forward<Args>(args)...);
-    }
 }
 
 template<typename G>
@@ -107,7 +107,6 @@ private:
         Move** toLast);
     // iterating in randomly ordered moves
     std::vector<Move> moves;
-    inline static std::vector<Move> sharedMoves = {};
     // lookup with O(1) access to items from moves
     std::vector<Move*> lookup;
     Move* first;
@@ -14,20 +14,11 @@ Moves::Moves(unsigned cellNum):
     pieceCellp(&pieceCell),
     pieceCellpp(&pieceCellp)
 {
-    // produce random order, but keep the same order among instances to prevent inconsistencies in assign function
-    // using a static sharedMoves object
-    if(sharedMoves.empty() || sharedMoves.size() != cellNum) // check if different board configuration was played before
-    {
-        moves.reserve(cellNum);
-        for(unsigned i=0; i<cellNum; ++i)
-            moves.push_back({i});
-        random_shuffle(moves.begin(), moves.end());
-        sharedMoves = moves;
-    }
-    else
-    {
-        moves = sharedMoves;
-    }
+    // produce random order, assign does not depend on the order so each instance can have its own
+    moves.reserve(cellNum);
+    for(unsigned i=0; i<cellNum; ++i)
+        moves.push_back({i});
+    random_shuffle(moves.begin(), moves.end());
     lookup.reserve(cellNum);
     for(unsigned idx=0; idx<cellNum; ++idx){
         for(unsigned i=0; i<cellNum; ++i){
@@ -53,14 +44,13 @@ Moves::Moves(unsigned cellNum):
 
 void Moves::assign(const Moves& other){
     // other should have the same board size
-    for(unsigned int i = 0; i < moves.size(); ++i){
-        auto prev = other.moves[i].prev;
-        moves[i].prev = prev ? lookup[prev->pos] : nullptr;
-
-        auto next = other.moves[i].next;
-        moves[i].next = next ? lookup[next->pos] : nullptr;
-
-        moves[i].piece = other.moves[i].piece;
+    // moves are matched by their position as the instances might be ordered differently
+    for(const auto& move : other.moves){
+        Move& curr = *lookup[move.pos];
+        curr.prev = move.prev ? lookup[move.prev->pos] : nullptr;
+        curr.next = move.next ? lookup[move.next->pos] : nullptr;
+        curr.player = move.player;
+        curr.piece = move.piece;
     }
 
     // we do not copy game with terminal state -> firstEmpty and lastEmpty are never nullptr
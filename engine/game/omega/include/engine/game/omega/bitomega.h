@@ -0,0 +1,324 @@
+#ifndef BITOMEGA_H
+#define BITOMEGA_H
+
+#include "engine/game/base/moves.h"
+#include "engine/game/base/game.h"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#if defined(__AVX2__) && !defined(OMEGA_SCALAR_FLOODFILL)
+#include <immintrin.h>
+#define OMEGA_SIMD_FLOODFILL
+#endif
+
+/**********************************************************************************
+ * Omega on bitboards                                                             *
+ * - Same game, moves and outcomes as Omega, with the board size fixed at compile *
+ * time (BitOmega<7> for board size 7). The cells are indexed the same way, so    *
+ * move indices are interchangeable between the two implementations               *
+ * - The pieces of each color are kept in a bitboard. Cell (q, r) is bit          *
+ * (q + N - 1) * 2N + r + N - 1, so each row of the hexagon has an unused bit     *
+ * after its last cell. The six neighbours of a cell are the bits at distance 1,  *
+ * 2N - 1 and 2N, shifts that wrap around a row land on an unused bit or on a     *
+ * cell outside the hexagon and are masked out                                    *
+ * - The groups are found by flood fill: starting from a piece the group is       *
+ * grown by the shifts of all six directions at once and masked by the pieces of  *
+ * its color until it stops growing. Its size is the popcount of the group        *
+ * - With AVX2 (-mavx2 or -march with AVX2) the flood fill works on 4 words at    *
+ * once, otherwise on one word at a time. OMEGA_SCALAR_FLOODFILL selects the      *
+ * scalar version even when AVX2 is available                                     *
+ **********************************************************************************/
+
+namespace BitOmegaDetail{
+    // bits of the cells in the order of Omega (row-by-row from left to right from top to bottom)
+    template<unsigned N, unsigned CELLNUM, unsigned ROWLEN>
+    constexpr std::array<unsigned, CELLNUM> cellBits(){
+        std::array<unsigned, CELLNUM> bits{};
+        const int size = N;
+        unsigned idx = 0;
+        for(int q = 1 - size; q < size; ++q){
+            for(int r = 1 - size; r < size; ++r){
+                if(q + r > -size && q + r < size)
+                    bits[idx++] = (q + size - 1) * ROWLEN + r + size - 1;
+            }
+        }
+        return bits;
+    }
+}
+
+template<unsigned N>
+class BitOmega: public Game<BitOmega<N>>
+{
+    static_assert(N >= 2 && N < 32, "BitOmega: board size should be between 2 and 31");
+public:
+    BitOmega(unsigned boardSize=N);
+
+    void assign(const BitOmega&); // assigment to update with root state after search is finished. It is a lightweight
+    // version of the correct assignment operator
+    BitOmega* clone() const; // independent instance with the same state for additional search threads
+    BitOmega& operator=(const BitOmega&)=delete;
+    BitOmega(const BitOmega&)=delete;
+    BitOmega& operator=(BitOmega&&)=delete;
+    BitOmega(BitOmega&&)=delete;
+
+    // ---- updates ----
+    void select(unsigned moveIdx);
+    // is required to update only the following:
+    // numSteps, depth, nextPiece, nextPlayer, stuff returned by available moves
+    void undo();
+
+    // ---- conversions ----
+
+    unsigned toPos(unsigned moveIdx) const { return moveIdx % CELLNUM; }
+    unsigned toPiece(unsigned moveIdx) const { return moveIdx / CELLNUM; }
+    // piece,pos -> moveIdx
+    unsigned toMoveIdx(unsigned piece, unsigned pos) const { return pos + piece * CELLNUM; }
+
+    // ---- queries ----
+
+    unsigned getLastPlayer() const;
+
+    // outcome in terminal state: 1 for WHITE, 0 for BLACK, 0.5 for draw
+    const std::array<double, 2>& scores();
+
+    Moves::Iterator& getValidMoves() { return moves.validMoves(); }
+    Moves::Iterator& getTakenMoves() { return moves.takenMoves(); }
+
+    Moves::Iterator& getLastMove() { return moves.takenMoves().rbegin(); }
+    unsigned getLastMoveIdx();
+
+    unsigned getMaxDepth() const { return numSteps; }
+
+    unsigned getBoardSize() const { return N; }
+
+    // total number of valid moves
+    unsigned getTotalValidMoveNum() const { return CELLNUM * 2; }
+    // maximum number of valid moves that can be played in a turn
+    unsigned getMaxValidMoveNum() const { return CELLNUM; }
+    // maximum number of turns (for both players)
+    unsigned getMaxTurnNum() const { return numSteps; }
+    // maximum number of turns for a player
+    unsigned getMaxPlayerTurnNum() const { return (numSteps + 2) / 4; }
+
+    bool end() const { return numSteps == 0; }
+
+    static constexpr unsigned PIECENUM = 2;
+    static constexpr unsigned CELLNUM = 3 * N * (N - 1) + 1;
+private:
+    typedef Game<BitOmega<N>> Base;
+
+    // bits of a row: the cells of the widest row and an unused bit
+    static constexpr unsigned ROWLEN = 2 * N;
+    static constexpr unsigned BITNUM = (2 * N - 1) * ROWLEN;
+#ifdef OMEGA_SIMD_FLOODFILL
+    static constexpr unsigned VECNUM = (BITNUM + 255) / 256;
+    static constexpr unsigned WORDNUM = 4 * VECNUM;
+#else
+    static constexpr unsigned WORDNUM = (BITNUM + 63) / 64;
+#endif
+    static constexpr std::array<unsigned, CELLNUM> CELLBITS = BitOmegaDetail::cellBits<N, CELLNUM, ROWLEN>();
+
+    typedef std::array<uint64_t, WORDNUM> Board;
+
+    // instance sharing the given root state, the root instance itself has no root
+    BitOmega(std::shared_ptr<BitOmega> root);
+
+    // grows group to the connected pieces of pieces
+    static void floodFill(Board& group, const Board& pieces);
+
+    // ---- variables ----
+    unsigned numSteps;
+    unsigned nextPiece;
+    // pieces of each color
+    std::array<Board, PIECENUM> boards;
+
+    std::array<double, 2> playerScores;
+    Moves moves;
+};
+
+// ---- initializations ----
+
+template<unsigned N>
+BitOmega<N>::BitOmega(unsigned boardSize): BitOmega(nullptr)
+{
+    if(boardSize != N)
+        throw std::invalid_argument( "BitOmega: board size should be " + std::to_string(N) );
+    Base::root.reset(new BitOmega(nullptr));
+    // same order of moves as this instance
+    Base::root->assign(*this);
+}
+
+template<unsigned N>
+BitOmega<N>::BitOmega(std::shared_ptr<BitOmega> root):
+    Base(std::move(root)),
+    // each player should have equal moves so we divide by 4
+    numSteps(CELLNUM - CELLNUM % 4),
+    nextPiece(0),
+    boards{},
+    moves(CELLNUM)
+{
+}
+
+template<unsigned N>
+void BitOmega<N>::assign(const BitOmega& other)
+{
+    moves.assign(other.moves);
+    boards = other.boards;
+    numSteps = other.numSteps;
+    Base::depth = other.depth;
+    nextPiece = other.nextPiece;
+    Base::nextPlayer = other.nextPlayer;
+}
+
+template<unsigned N>
+BitOmega<N>* BitOmega<N>::clone() const
+{
+    BitOmega* game = new BitOmega(Base::root);
+    game->assign(*this);
+    return game;
+}
+
+// ----- updates ------
+
+template<unsigned N>
+void BitOmega<N>::select(unsigned moveIdx)
+{
+    unsigned pos = toPos(moveIdx);
+    moves.add(Base::nextPlayer, nextPiece, pos);
+    unsigned bit = CELLBITS[pos];
+    boards[nextPiece][bit / 64] |= uint64_t(1) << (bit % 64);
+    --numSteps;
+    ++Base::depth;
+    nextPiece = Base::depth & 1u;          // modulo 2 -> every turn switch piece color
+    Base::nextPlayer = (Base::depth & 2u) >> 1u; // every second turn switch players
+    moves.updateNextPiece(nextPiece);
+}
+
+template<unsigned N>
+void BitOmega<N>::undo()
+{
+    ++numSteps;
+    --Base::depth;
+    nextPiece = Base::depth & 1u;  // modulo 2 -> every turn switch piece color
+    Base::nextPlayer = (Base::depth & 2u) >> 1u; // every second turn switch players
+    // no need to update moves and boards as they only used at the terminal state when calculating the outcome
+}
+
+// ----- queries ------
+
+#ifdef OMEGA_SIMD_FLOODFILL
+
+template<unsigned N>
+void BitOmega<N>::floodFill(Board& group, const Board& pieces)
+{
+    __m256i groups[VECNUM];
+    __m256i masks[VECNUM];
+    for(unsigned vec = 0; vec < VECNUM; ++vec){
+        groups[vec] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group.data() + 4 * vec));
+        masks[vec] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pieces.data() + 4 * vec));
+    }
+    bool grown = true;
+    while(grown){
+        grown = false;
+        __m256i next[VECNUM];
+        for(unsigned vec = 0; vec < VECNUM; ++vec){
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i curr = groups[vec];
+            __m256i prevVec = vec ? groups[vec - 1] : zero;
+            __m256i nextVec = vec + 1 < VECNUM ? groups[vec + 1] : zero;
+            // words shifted by one: lower holds the word below each word, upper the word above it
+            __m256i lower = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(prevVec, curr, 0x21), 8);
+            __m256i upper = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, nextVec, 0x21), curr, 8);
+            __m256i grownVec = _mm256_or_si256(
+                _mm256_or_si256(
+                    _mm256_or_si256(_mm256_slli_epi64(curr, 1), _mm256_srli_epi64(lower, 63)),
+                    _mm256_or_si256(_mm256_srli_epi64(curr, 1), _mm256_slli_epi64(upper, 63))),
+                _mm256_or_si256(
+                    _mm256_or_si256(
+                        _mm256_or_si256(_mm256_slli_epi64(curr, ROWLEN), _mm256_srli_epi64(lower, 64 - ROWLEN)),
+                        _mm256_or_si256(_mm256_srli_epi64(curr, ROWLEN), _mm256_slli_epi64(upper, 64 - ROWLEN))),
+                    _mm256_or_si256(
+                        _mm256_or_si256(_mm256_slli_epi64(curr, ROWLEN - 1), _mm256_srli_epi64(lower, 65 - ROWLEN)),
+                        _mm256_or_si256(_mm256_srli_epi64(curr, ROWLEN - 1), _mm256_slli_epi64(upper, 65 - ROWLEN)))));
+            next[vec] = _mm256_and_si256(_mm256_or_si256(curr, grownVec), masks[vec]);
+            __m256i diff = _mm256_xor_si256(next[vec], curr);
+            grown |= !_mm256_testz_si256(diff, diff);
+        }
+        for(unsigned vec = 0; vec < VECNUM; ++vec)
+            groups[vec] = next[vec];
+    }
+    for(unsigned vec = 0; vec < VECNUM; ++vec)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(group.data() + 4 * vec), groups[vec]);
+}
+
+#else
+
+template<unsigned N>
+void BitOmega<N>::floodFill(Board& group, const Board& pieces)
+{
+    bool grown = true;
+    while(grown){
+        grown = false;
+        Board next;
+        for(unsigned word = 0; word < WORDNUM; ++word){
+            uint64_t curr = group[word];
+            // bits shifted over the word boundaries
+            uint64_t lower = word ? group[word - 1] : 0;
+            uint64_t upper = word + 1 < WORDNUM ? group[word + 1] : 0;
+            uint64_t grownWord = curr << 1 | lower >> 63 | curr >> 1 | upper << 63 |
+                                 curr << ROWLEN | lower >> (64 - ROWLEN) | curr >> ROWLEN | upper << (64 - ROWLEN) |
+                                 curr << (ROWLEN - 1) | lower >> (65 - ROWLEN) | curr >> (ROWLEN - 1) | upper << (65 - ROWLEN);
+            next[word] = (curr | grownWord) & pieces[word];
+            grown |= next[word] != curr;
+        }
+        group = next;
+    }
+}
+
+#endif
+
+template<unsigned N>
+const std::array<double, 2>& BitOmega<N>::scores()
+{
+    for(unsigned piece = 0; piece < PIECENUM; ++piece){
+        playerScores[piece] = 1;
+        // pieces that are not in any of the groups found so far
+        Board rest = boards[piece];
+        for(unsigned word = 0; word < WORDNUM; ++word){
+            while(rest[word]){
+                // the group of the lowest remaining piece
+                Board group{};
+                group[word] = rest[word] & -rest[word];
+                floodFill(group, rest);
+                unsigned groupSize = 0;
+                for(unsigned idx = word; idx < WORDNUM; ++idx){
+                    groupSize += __builtin_popcountll(group[idx]);
+                    rest[idx] &= ~group[idx];
+                }
+                playerScores[piece] *= groupSize;
+            }
+        }
+    }
+    return playerScores;
+}
+
+template<unsigned N>
+unsigned BitOmega<N>::getLastPlayer() const
+{
+    if(nextPiece)
+        return Base::nextPlayer;
+    else
+        return 1 - Base::nextPlayer;
+}
+
+template<unsigned N>
+unsigned BitOmega<N>::getLastMoveIdx()
+{
+    const auto& lastMove = getLastMove();
+    return toMoveIdx(lastMove.getPiece(), lastMove.getPos());
+}
+
+#endif // BITOMEGA_H
@@ -17,10 +17,9 @@ public:
     };
 
     struct Hexagon{
-        Hexagon(unsigned idx): idx(idx), mark(false) {}
+        Hexagon(unsigned idx): idx(idx) {}
         // indices of hexagons (row-by-row from left to right from top to bottom)
         unsigned idx;
-        bool mark; // used to indicate if note is visited or not for BFS
         std::vector<Hexagon*> neighbours;
     };
 
@@ -28,6 +27,7 @@ public:
 
     void assign(const Omega&); // assigment to update with root state after search is finished. It is a lightweight
     // version of the correct assignment operator
+    Omega* clone() const; // independent instance with the same state for additional search threads
     Omega& operator=(const Omega&)=delete;
     Omega(const Omega&)=delete;
     Omega& operator=(Omega&&)=delete;
@@ -37,6 +37,7 @@ public:
     void select(unsigned moveIdx);
     // is required to update only the following:
     // numSteps, depth, nextPiece, nextPlayer, stuff returned by available moves
+    // the groups are rolled back as well
     void undo();
 
     // ---- conversions ----
@@ -53,6 +54,7 @@ public:
     unsigned getLastPlayer() const;
 
     // outcome in terminal state: 1 for WHITE, 0 for BLACK, 0.5 for draw
+    // product of the sizes of the groups tracked by select
     const std::array<double, 2>& scores();
 
     Moves::Iterator& getValidMoves();
@@ -63,6 +65,8 @@ public:
 
     unsigned getMaxDepth() const;
 
+    unsigned getBoardSize() const;
+
     // total number of valid moves
     unsigned getTotalValidMoveNum() const;
     // maximum number of valid moves that can be played in a turn
@@ -76,6 +80,9 @@ public:
 
     static constexpr unsigned PIECENUM = 2;
 private:
+    // instance sharing the given root state, the root instance itself has no root
+    Omega(unsigned boardSize, std::shared_ptr<Omega> root);
+
     // ---- initialization ----
     void initCells();
     void setNeighbours(Hexagon& hex, const std::vector<std::vector<Hexagon*>>& board, int q, int r);
@@ -86,17 +93,43 @@ private:
     inline bool isValidAx(const Ax& ax);
     inline unsigned computeCellNum(unsigned boardSize) const;
 
+    // ---- groups ----
+    // root cell of the group of the piece at pos
+    unsigned findRoot(unsigned pos) const;
+    // merges the groups of the given roots, returns the root of the merged group
+    unsigned merge(unsigned root, unsigned other);
+
     // ---- variables ----
     unsigned numSteps;
     const int boardSize;
     std::vector<Hexagon> hexagons;
 
     std::array<double, 2> playerScores;
-    std::vector<Hexagon*> queue;
+
+    // union-find of the pieces of the same color. It is linked by size without path compression so merges
+    // can be undone in reverse order
+    struct Step{
+        unsigned pos;
+        // number of merges before the piece was placed
+        unsigned mergeNum;
+    };
+    // neighbours of each cell in 6 slots, the missing ones are filled up with cellNum
+    std::vector<unsigned> neighbourIdxs;
+    // piece on each cell, PIECENUM for empty cells and cellNum
+    std::vector<unsigned> pieces;
+    // parent cell in the group, the root is its own parent
+    std::vector<unsigned> parents;
+    // number of pieces in the group, valid for the roots
+    std::vector<unsigned> groupSizes;
+    // roots of the groups and their indices in roots
+    std::vector<unsigned> roots;
+    std::vector<unsigned> rootIdxs;
+    // placed pieces and the roots merged into other groups, popped by undo
+    std::vector<Step> steps;
+    std::vector<unsigned> merges;
 
     unsigned nextPiece;
     const unsigned cellNum;
-    bool mark;
     Moves moves;
 };
 
@@ -7,17 +7,31 @@ using namespace std;
 
 // ---- initializations ----
 
-Omega::Omega(unsigned boardSize) :   Game<Omega>(boardSize),
+Omega::Omega(unsigned boardSize) : Omega(boardSize, nullptr)
+{
+    root.reset(new Omega(boardSize, nullptr));
+    // same order of moves as this instance
+    root->assign(*this);
+}
+
+Omega::Omega(unsigned boardSize, std::shared_ptr<Omega> root) :
+                                     Game<Omega>(std::move(root)),
                                      boardSize{boardSize},
                                      cellNum{computeCellNum(boardSize)},
                                      moves{cellNum},
-                                     nextPiece(0),
-                                     mark(true)
+                                     nextPiece(0)
 {
     // each player should have equal moves so we divide by 4
     numSteps = cellNum - cellNum % 4;
 
-    queue.reserve(numSteps);
+    pieces.resize(cellNum + 1, PIECENUM);
+    parents.resize(cellNum);
+    groupSizes.resize(cellNum);
+    rootIdxs.resize(cellNum);
+    // at most one root, step and merge for each piece so select never allocates
+    roots.reserve(cellNum);
+    steps.reserve(cellNum);
+    merges.reserve(cellNum);
     // we need as much bits to be able to represent each cell on the board
     initCells();
 }
@@ -29,6 +43,21 @@ void Omega::assign(const Omega &other)
     depth = other.depth;
     nextPiece = other.nextPiece;
     nextPlayer = other.nextPlayer;
+    // same sizes as other so the vectors are copied without allocation
+    pieces = other.pieces;
+    parents = other.parents;
+    groupSizes = other.groupSizes;
+    roots = other.roots;
+    rootIdxs = other.rootIdxs;
+    steps = other.steps;
+    merges = other.merges;
+}
+
+Omega* Omega::clone() const
+{
+    Omega* game = new Omega(boardSize, root);
+    game->assign(*this);
+    return game;
 }
 
 unsigned Omega::computeCellNum(unsigned boardSize) const
@@ -114,6 +143,13 @@ void Omega::initCells()
     }
     for (unsigned int i = 0; i < cellNum; ++i)
         setNeighbours(hexagons[i], board, axes[i].q, axes[i].r);
+    // flat copy of the neighbours for the group updates
+    neighbourIdxs.resize(6 * cellNum, cellNum);
+    for (unsigned int i = 0; i < cellNum; ++i)
+    {
+        for (unsigned int j = 0; j < hexagons[i].neighbours.size(); ++j)
+            neighbourIdxs[6 * i + j] = hexagons[i].neighbours[j]->idx;
+    }
 }
 
 // ----- updates ------
@@ -122,7 +158,26 @@ void Omega::select(unsigned moveIdx)
 {
     unsigned pos = toPos(moveIdx);
     moves.add(nextPlayer, nextPiece, pos);
-    hexagons[pos].mark = mark; // update with new mark
+    // the piece is a new group merged with the groups of its neighbours of the same color
+    steps.push_back({pos, static_cast<unsigned>(merges.size())});
+    pieces[pos] = nextPiece;
+    parents[pos] = pos;
+    groupSizes[pos] = 1;
+    rootIdxs[pos] = roots.size();
+    roots.push_back(pos);
+    unsigned root = pos;
+    const unsigned *neighbours = &neighbourIdxs[6 * pos];
+    unsigned same = 0;
+    for (unsigned i = 0; i < 6; ++i)
+        same |= unsigned(pieces[neighbours[i]] == nextPiece) << i;
+    // consecutive neighbours are neighbours of each other so they are already in the same group,
+    // only the first neighbour of each run of the same color is merged
+    for (unsigned firsts = same & ~(same << 1); firsts; firsts &= firsts - 1)
+    {
+        unsigned other = findRoot(neighbours[__builtin_ctz(firsts)]);
+        if (other != root)
+            root = merge(root, other);
+    }
     --numSteps;
     ++depth;
     nextPiece = depth & 1u;          // modulo 2 -> every turn switch piece color
@@ -137,6 +192,54 @@ void Omega::undo()
     nextPiece = depth & 1u;  // modulo 2 -> every turn switch piece color
     nextPlayer = (depth & 2u) >> 1u; // every second turn switch players
     // no need to update moves as they only used at the terminal state when calculating the outcome
+    // the merges of the last piece are undone in reverse order
+    const Step& step = steps.back();
+    while (merges.size() > step.mergeNum)
+    {
+        unsigned other = merges.back();
+        merges.pop_back();
+        groupSizes[parents[other]] -= groupSizes[other];
+        parents[other] = other;
+        // other takes back its index from the root that was moved there
+        unsigned idx = rootIdxs[other];
+        if (idx == roots.size())
+            roots.push_back(other);
+        else
+        {
+            rootIdxs[roots[idx]] = roots.size();
+            roots.push_back(roots[idx]);
+            roots[idx] = other;
+        }
+    }
+    // the piece is the last root again
+    roots.pop_back();
+    pieces[step.pos] = PIECENUM;
+    steps.pop_back();
+}
+
+// ----- groups ------
+
+unsigned Omega::findRoot(unsigned pos) const
+{
+    while (parents[pos] != pos)
+        pos = parents[pos];
+    return pos;
+}
+
+unsigned Omega::merge(unsigned root, unsigned other)
+{
+    // the smaller group is linked to the larger one so the groups stay shallow
+    if (groupSizes[root] < groupSizes[other])
+        std::swap(root, other);
+    parents[other] = root;
+    groupSizes[root] += groupSizes[other];
+    // the last root takes the index of other
+    unsigned last = roots.back();
+    roots[rootIdxs[other]] = last;
+    rootIdxs[last] = rootIdxs[other];
+    roots.pop_back();
+    merges.push_back(other);
+    return root;
 }
 
 // ----- queries ------
@@ -150,47 +253,9 @@ const array<double, 2>& Omega::scores()
 {
     playerScores[0] = 1;
     playerScores[1] = 1;
-    unsigned start = 0;
-    unsigned end = 0;
-    for (const auto& move : moves.takenMoves())
-    {
-        // BFS on each occupied hexagons to get the connected groups, then multiply their sizes together
-        unsigned groupSize = 0;
-        unsigned pos = move.getPos();
-        unsigned piece = move.getPiece();
-        if (hexagons[pos].mark == mark)
-        { // visited ? taken so should not be empty
-            hexagons[pos].mark = !mark;
-            ++groupSize;
-            queue[end] = &hexagons[pos];
-            ++end;
-            while (end - start > 0)
-            { // not empty
-                auto hex = queue[start];
-                for (Hexagon *neighbour : hex->neighbours)
-                {
-                    if (neighbour->mark == mark && piece == moves[neighbour->idx].piece)
-                    {                            // visited ?, same type of piece as seed ?
-                        neighbour->mark = !mark; // set to visited
-                        queue[end] = neighbour;  // add to queue
-                        ++groupSize;
-                        ++end;
-                    }
-                }
-                ++start; // remove front from queue
-            }
-            playerScores[piece] *= groupSize;
-        }
-    }
-    // set rest of the hexagons to visited
-    for (const auto& emptyCell : moves.validMoves())
-    {
-        hexagons[emptyCell.getPos()].mark = !mark;
-    }
-    // negate mark so no need to update marks for every hexagon when calling score next time
-    mark = !mark;
-    start = 0;
-    end = 0;
+    // the groups are tracked by select, multiply their sizes together
+    for (unsigned root : roots)
+        playerScores[pieces[root]] *= groupSizes[root];
     return playerScores;
 }
 
@@ -228,6 +293,11 @@ unsigned Omega::getMaxDepth() const
     return numSteps;
 }
 
+unsigned Omega::getBoardSize() const
+{
+    return boardSize;
+}
+
 unsigned Omega::getTotalValidMoveNum() const
 {
     return cellNum * 2;
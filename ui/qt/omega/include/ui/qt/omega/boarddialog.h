@@ -24,6 +24,9 @@ struct ComputerData{
     QString version, node, policy;
     bool recycling;
     unsigned budget;
+    unsigned threadNum;
+    // search during the turns of the opponent
+    bool pondering;
 };
 
 struct Player;
@@ -106,6 +109,8 @@ struct Player: public QObject{
     virtual void play()=0;
     virtual void stop()=0;
     virtual void reset()=0;
+    // releases resources holding game instances before the game is recreated
+    virtual void release(){}
     virtual boost::optional<std::string> getErrorMsg() const=0;
     virtual bool isInterrupted() const{
         return false;
@@ -216,7 +221,7 @@ public:
     virtual void reset() override{
         impl = [this]() -> std::shared_ptr<AiBotBase>{
             if(params.version == "MCTS")
-                return std::make_shared<MCTSBot>(*(board.game), params.node.toStdString(), params.policy.toStdString(), params.recycling, params.budget);
+                return std::make_shared<MCTSBot>(*(board.game), params.node.toStdString(), params.policy.toStdString(), params.recycling, params.budget, params.threadNum, "tree", params.pondering);
             else if(params.version == "random")
                 return std::make_shared<RandomBot<Omega>>(*(board.game));
             else
@@ -224,6 +229,9 @@ public:
         }();
         initTimer();
     }
+    virtual void release() override{
+        impl = nullptr;
+    }
     virtual boost::optional<std::string> getErrorMsg() const override{
         return errorMsg;
     }
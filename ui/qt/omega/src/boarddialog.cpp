@@ -43,6 +43,9 @@ void BoardDialog::on_startButton_clicked()
         QMessageBox::StandardButton reply;
         reply = QMessageBox::question(this, "Restart", "Are you sure want to restart the game?", QMessageBox::Yes|QMessageBox::No);
         if(reply == QMessageBox::Yes){
+            // search threads of the bots hold their own game instances sharing the root state
+            players[0]->release();
+            players[1]->release();
             game = nullptr; // delete shared state
             game = make_shared<Omega>(boardSize);
             players[0]->reset();
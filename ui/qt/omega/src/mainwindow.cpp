@@ -134,6 +134,9 @@ MainWindow::MainWindow(double padding, double radius) :
 
     ui->nodeComboBox1->addItem(QString("RAVE"));
     ui->nodeComboBox1->addItem(QString("UCT-2"));
+    ui->nodeComboBox1->addItem(QString("RAVE-sparse"));
+    ui->nodeComboBox1->addItem(QString("RAVE-compact"));
+    ui->nodeComboBox1->addItem(QString("UCT-2-compact"));
     ui->nodeComboBox1->setCurrentIndex(0);
 
     ui->policyComboBox1->addItem(QString("random"));
@@ -160,6 +163,9 @@ MainWindow::MainWindow(double padding, double radius) :
 
     ui->nodeComboBox2->addItem(QString("RAVE"));
     ui->nodeComboBox2->addItem(QString("UCT-2"));
+    ui->nodeComboBox2->addItem(QString("RAVE-sparse"));
+    ui->nodeComboBox2->addItem(QString("RAVE-compact"));
+    ui->nodeComboBox2->addItem(QString("UCT-2-compact"));
     ui->nodeComboBox2->setCurrentIndex(0);
 
     ui->policyComboBox2->addItem(QString("random"));
@@ -198,6 +204,7 @@ void MainWindow::on_startButton_clicked()
     boost::optional<ComputerData> params2 = boost::none;
     unsigned time1, time2, from;
 
+    // engines only ponder against a human player so they do not compete for the cores
     #define CREATECOMPUTER(index)                                                                   \
         time ## index = getSecsFromTimeSlider ## index();                                           \
         QString version ## index = ui->engineComboBox ## index->currentText();                      \
@@ -210,7 +217,9 @@ void MainWindow::on_startButton_clicked()
             node ## index,                                                                          \
             policy ## index,                                                                        \
             recycling ## index,                                                                     \
-            budget ## index});                                                                      \
+            budget ## index,                                                                        \
+            static_cast<unsigned>(std::max(1, QThread::idealThreadCount())),                        \
+            mode == "PvComp"});                                                                     \
     
     if(mode == "PvP"){
         time1 = time2 = getSecsFromTimeSliderMain();